@@ -5,6 +5,7 @@
 #include <sys/types.h>    
 #include <sys/socket.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 namespace
@@ -14,7 +15,7 @@ namespace
     int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0) 
     {
-        LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __func__, __LINE__, errno);
+        LOG_FATAL("{}:{}:{} listen socket create err:{} \n", __FILE__, __func__, __LINE__, errno);
     }
     return sockfd;
 }
@@ -25,6 +26,7 @@ Acceptor::Acceptor(EventLoop *inLoop, const InetAddress &inListenAddr, bool inRe
     , m_acceptSocket(createNonblocking())
     , m_acceptChannel(inLoop, m_acceptSocket.fd())
     , m_listenning(false)
+    , m_idleFd(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
     m_acceptSocket.setReuseAddr(true);
     m_acceptSocket.setReusePort(inReusePort);
@@ -36,6 +38,10 @@ Acceptor::~Acceptor()
 {
     m_acceptChannel.disableAll();
     m_acceptChannel.remove();
+    if (m_idleFd >= 0)
+    {
+        ::close(m_idleFd);
+    }
 }
 
 void Acceptor::listen()
@@ -45,27 +51,92 @@ void Acceptor::listen()
     m_acceptChannel.enableReading();
 }
 
+void Acceptor::pauseAccepting()
+{
+    if (m_listenning && m_acceptChannel.isReading())
+    {
+        m_acceptChannel.disableReading();
+    }
+}
+
+void Acceptor::resumeAccepting()
+{
+    if (m_listenning && !m_acceptChannel.isReading())
+    {
+        m_acceptChannel.enableReading();
+    }
+}
+
+Acceptor::Stats Acceptor::stats() const noexcept
+{
+    Stats stats;
+    stats.accepted = m_acceptedCount.load(std::memory_order_relaxed);
+    stats.rejected = m_rejectedCount.load(std::memory_order_relaxed);
+    stats.batches = m_batchCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connectionFd = m_acceptSocket.accept(&peerAddr);
-    if (connectionFd >= 0)
+    int accepted = 0;
+    // Every accept() call counts toward the batch, including ones retried after
+    // EINTR/ECONNABORTED, so a stream of aborted handshakes cannot hold the loop.
+    // The callback may pause accepting, e.g. when a connection limit is reached
+    for (int attempts = 0; attempts < m_batchSize && m_acceptChannel.isReading(); ++attempts)
     {
-        if (m_newConnectionCallback)
+        InetAddress peerAddr;
+        int connectionFd = m_acceptSocket.accept(&peerAddr);
+        if (connectionFd >= 0)
         {
-            m_newConnectionCallback(connectionFd, peerAddr);
+            ++accepted;
+            if (m_newConnectionCallback)
+            {
+                m_newConnectionCallback(connectionFd, peerAddr);
+            }
+            else
+            {
+                ::close(connectionFd);
+            }
+            continue;
         }
-        else
+
+        const int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
         {
-            ::close(connectionFd);
+            break;  // backlog drained
         }
-    }
-    else
-    {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __func__, __LINE__, errno);
-        if (errno == EMFILE)
+        if (savedErrno == EINTR || savedErrno == ECONNABORTED)
+        {
+            continue;
+        }
+        LOG_ERROR("{}:{}:{} accept err:{} \n", __FILE__, __func__, __LINE__, savedErrno);
+        if (savedErrno == EMFILE || savedErrno == ENFILE)
         {
-            LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __func__, __LINE__);
+            LOG_ERROR("{}:{}:{} sockfd reached limit! \n", __FILE__, __func__, __LINE__);
+            rejectWithSpareFd();
         }
+        break;
+    }
+
+    if (accepted > 0)
+    {
+        m_acceptedCount.fetch_add(accepted, std::memory_order_relaxed);
+        m_batchCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Acceptor::rejectWithSpareFd()
+{
+    if (m_idleFd < 0)
+    {
+        return;
+    }
+    ::close(m_idleFd);
+    int connectionFd = ::accept(m_acceptSocket.fd(), nullptr, nullptr);
+    if (connectionFd >= 0)
+    {
+        ::close(connectionFd);
+        m_rejectedCount.fetch_add(1, std::memory_order_relaxed);
     }
+    m_idleFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
 }
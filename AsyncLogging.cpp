@@ -0,0 +1,150 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+#include "Timestamp.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+void AsyncLogging::LogBuffer::append(const char *inData, size_t inLen) noexcept
+{
+    std::memcpy(data + len, inData, inLen);
+    len += inLen;
+}
+
+AsyncLogging::AsyncLogging(std::string inBasename,
+                           int inFlushIntervalSeconds,
+                           size_t inMaxPendingBuffers)
+    : m_basename(std::move(inBasename))
+    , m_flushIntervalSeconds(inFlushIntervalSeconds)
+    , m_maxPendingBuffers(inMaxPendingBuffers)
+    , m_thread([this]() { threadFunc(); }, "AsyncLogging")
+    , m_currentBuffer(std::make_unique<LogBuffer>())
+    , m_nextBuffer(std::make_unique<LogBuffer>())
+{
+    m_buffers.reserve(inMaxPendingBuffers);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (m_running)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    m_running = true;
+    m_thread.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+void AsyncLogging::append(const char *inLine, size_t inLen)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_currentBuffer->avail() > inLen)
+    {
+        m_currentBuffer->append(inLine, inLen);
+        return;
+    }
+    if (inLen > kBufferSize || m_buffers.size() >= m_maxPendingBuffers)
+    {
+        // Backend is behind: drop rather than grow without bound
+        m_droppedBytes += inLen;
+        m_droppedTotal.fetch_add(inLen, std::memory_order_relaxed);
+        return;
+    }
+
+    m_buffers.push_back(std::move(m_currentBuffer));
+    m_currentBuffer = m_nextBuffer ? std::move(m_nextBuffer) : std::make_unique<LogBuffer>();
+    m_currentBuffer->append(inLine, inLen);
+    m_cond.notify_one();
+}
+
+void AsyncLogging::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_running)
+    {
+        return;
+    }
+    const uint64_t generation = ++m_flushRequested;
+    m_cond.notify_one();
+    m_flushedCond.wait(lock, [this, generation]() { return m_flushed >= generation || !m_running; });
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(m_basename);
+    BufferPtr spare1 = std::make_unique<LogBuffer>();
+    BufferPtr spare2 = std::make_unique<LogBuffer>();
+    std::vector<BufferPtr> buffersToWrite;
+    buffersToWrite.reserve(m_maxPendingBuffers + 1);
+
+    bool running = true;
+    while (running)
+    {
+        uint64_t dropped = 0;
+        uint64_t flushGeneration = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_buffers.empty() && m_running && m_flushRequested == m_flushed)
+            {
+                m_cond.wait_for(lock, std::chrono::seconds(m_flushIntervalSeconds));
+            }
+            running = m_running;
+            m_buffers.push_back(std::move(m_currentBuffer));
+            m_currentBuffer = std::move(spare1);
+            buffersToWrite.swap(m_buffers);
+            if (!m_nextBuffer)
+            {
+                m_nextBuffer = std::move(spare2);
+            }
+            dropped = m_droppedBytes;
+            m_droppedBytes = 0;
+            flushGeneration = m_flushRequested;
+        }
+
+        if (dropped > 0)
+        {
+            char notice[160];
+            const int len = snprintf(notice, sizeof(notice),
+                                     "[ERROR]%s : AsyncLogging dropped %lu bytes of log messages\n",
+                                     Timestamp::now().toString().c_str(), static_cast<unsigned long>(dropped));
+            output.append(notice, static_cast<size_t>(len));
+        }
+        for (const BufferPtr &buffer : buffersToWrite)
+        {
+            output.append(buffer->data, buffer->len);
+        }
+
+        // Keep two buffers for the next swap and release the rest
+        for (BufferPtr *spare : {&spare1, &spare2})
+        {
+            if (!*spare && !buffersToWrite.empty())
+            {
+                *spare = std::move(buffersToWrite.back());
+                buffersToWrite.pop_back();
+                (*spare)->len = 0;
+            }
+        }
+        buffersToWrite.clear();
+        output.flush();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_flushed = flushGeneration;
+        }
+        m_flushedCond.notify_all();
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Asynchronous, double-buffered log backend
+ *
+ * Front end: append() copies a formatted line into the current in-memory buffer
+ * under a short lock; no syscalls are made on the logging thread. Full buffers
+ * are handed to a background thread, which writes them to a LogFile in large
+ * batches and flushes at least every flush interval.
+ *
+ * Memory is bounded: when the backend falls behind and inMaxPendingBuffers full
+ * buffers are already queued, new lines are dropped and counted; the backend
+ * records how much was lost in the file.
+ *
+ * Typical use:
+ *   AsyncLogging log("server");
+ *   log.start();
+ *   Logger::instance().setOutput([&log](const char *msg, size_t len) { log.append(msg, len); });
+ *   Logger::instance().setFlush([&log]() { log.flush(); });
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    static constexpr size_t kBufferSize = 4 * 1024 * 1024;
+
+    /**
+     * @param inBasename Log file basename, see LogFile
+     * @param inFlushIntervalSeconds Longest time a line waits in memory
+     * @param inMaxPendingBuffers Full buffers queued before lines are dropped
+     */
+    explicit AsyncLogging(std::string inBasename,
+                          int inFlushIntervalSeconds = 3,
+                          size_t inMaxPendingBuffers = 16);
+    ~AsyncLogging();
+
+    /**
+     * @brief Queue one formatted line; thread-safe
+     */
+    void append(const char *inLine, size_t inLen);
+
+    /**
+     * @brief Block until everything appended so far has been written and flushed
+     * @note Must not be called from the backend thread
+     */
+    void flush();
+
+    void start();
+    void stop();
+
+    [[nodiscard]] uint64_t droppedBytes() const noexcept
+    { return m_droppedTotal.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @brief Fixed-size chunk of formatted log lines
+     */
+    struct LogBuffer
+    {
+        size_t avail() const noexcept { return kBufferSize - len; }
+        void append(const char *inData, size_t inLen) noexcept;
+
+        size_t len{0};
+        char data[kBufferSize];
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+
+    void threadFunc();
+
+    const std::string m_basename;
+    const int m_flushIntervalSeconds;
+    const size_t m_maxPendingBuffers;
+
+    std::atomic<bool> m_running{false};
+    muduoModernCpp::Thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;         // wakes the backend
+    std::condition_variable m_flushedCond;  // wakes flush() callers
+    BufferPtr m_currentBuffer;
+    BufferPtr m_nextBuffer;
+    std::vector<BufferPtr> m_buffers;       // full buffers waiting for the backend
+    uint64_t m_droppedBytes{0};             // dropped since the backend last reported
+    uint64_t m_flushRequested{0};           // flush() generation requested
+    uint64_t m_flushed{0};                  // flush() generation completed
+    std::atomic<uint64_t> m_droppedTotal{0};
+};
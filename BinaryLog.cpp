@@ -0,0 +1,407 @@
+#include "BinaryLog.h"
+#include "Logger.h"
+
+#include <chrono>
+#include <ctime>
+#include <unordered_map>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char kMagic[8] = {'M', 'U', 'D', 'U', 'O', 'B', 'L', '1'};
+
+// Entry tags in the file, each followed by its fields
+constexpr char kSiteEntry = 'S';     // id, level, line, file, format, signature
+constexpr char kChunkEntry = 'C';    // thread id, length, records
+constexpr char kDroppedEntry = 'D';  // thread id, records dropped since the last entry
+
+template <typename T>
+void put(FILE *outFile, const T &inValue)
+{
+    ::fwrite(&inValue, sizeof(inValue), 1, outFile);
+}
+
+void putString(FILE *outFile, std::string_view inText)
+{
+    const auto len = static_cast<uint16_t>(std::min<size_t>(inText.size(), UINT16_MAX));
+    put(outFile, len);
+    ::fwrite(inText.data(), 1, len, outFile);
+}
+
+template <typename T>
+bool get(FILE *inFile, T *outValue)
+{
+    return ::fread(outValue, sizeof(*outValue), 1, inFile) == 1;
+}
+
+bool getString(FILE *inFile, std::string *outText)
+{
+    uint16_t len = 0;
+    if (!get(inFile, &len))
+    {
+        return false;
+    }
+    outText->resize(len);
+    return len == 0 || ::fread(outText->data(), 1, len, inFile) == len;
+}
+
+size_t roundUpToPowerOfTwo(size_t inValue)
+{
+    size_t result = 4096;
+    while (result < inValue)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+/**
+ * @brief Keeps the thread's ring registered until the persister has drained it
+ */
+struct ThreadBufferHolder
+{
+    ~ThreadBufferHolder()
+    {
+        if (buffer)
+        {
+            buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+    std::shared_ptr<logdetail::StagingBuffer> buffer;
+};
+
+thread_local ThreadBufferHolder t_bufferHolder;
+
+/**
+ * @brief Reads the next typed argument from a record payload
+ */
+class PayloadReader
+{
+public:
+    PayloadReader(const char *inData, size_t inLen) : m_data(inData), m_len(inLen) {}
+
+    template <typename T>
+    T read()
+    {
+        T value{};
+        if (m_pos + sizeof(T) <= m_len)
+        {
+            std::memcpy(&value, m_data + m_pos, sizeof(T));
+        }
+        m_pos += sizeof(T);
+        return value;
+    }
+
+    std::string_view readString()
+    {
+        const auto len = read<uint32_t>();
+        if (m_pos + len > m_len)
+        {
+            m_pos = m_len;
+            return {};
+        }
+        std::string_view text(m_data + m_pos, len);
+        m_pos += len;
+        return text;
+    }
+
+private:
+    const char *m_data;
+    size_t m_len;
+    size_t m_pos{0};
+};
+
+void appendDecodedArg(logdetail::LogLine &outLine, char inCode, PayloadReader &ioReader)
+{
+    switch (inCode)
+    {
+    case '?': logdetail::appendArg(outLine, ioReader.read<bool>()); break;
+    case 'c': logdetail::appendArg(outLine, ioReader.read<char>()); break;
+    case 'b': logdetail::appendArg(outLine, ioReader.read<int8_t>()); break;
+    case 'h': logdetail::appendArg(outLine, ioReader.read<int16_t>()); break;
+    case 'i': logdetail::appendArg(outLine, ioReader.read<int32_t>()); break;
+    case 'l': logdetail::appendArg(outLine, ioReader.read<int64_t>()); break;
+    case 'B': logdetail::appendArg(outLine, ioReader.read<uint8_t>()); break;
+    case 'H': logdetail::appendArg(outLine, ioReader.read<uint16_t>()); break;
+    case 'I': logdetail::appendArg(outLine, ioReader.read<uint32_t>()); break;
+    case 'L': logdetail::appendArg(outLine, ioReader.read<uint64_t>()); break;
+    case 'd': logdetail::appendArg(outLine, ioReader.read<double>()); break;
+    case 's': logdetail::appendArg(outLine, ioReader.readString()); break;
+    case 'p': logdetail::appendArg(outLine, reinterpret_cast<const void*>(ioReader.read<uint64_t>())); break;
+    default: outLine.append("?"); break;
+    }
+}
+}  // namespace
+
+logdetail::StagingBuffer::StagingBuffer(size_t inCapacity, uint32_t inThreadId)
+    : m_capacity(inCapacity)
+    , m_threadId(inThreadId)
+    , m_data(std::make_unique<char[]>(inCapacity))
+{
+}
+
+BinaryLog& BinaryLog::instance()
+{
+    static BinaryLog log;
+    return log;
+}
+
+bool BinaryLog::start(const std::string &inPath, size_t inBufferBytes)
+{
+    if (m_running)
+    {
+        return false;
+    }
+    m_file = ::fopen(inPath.c_str(), "wbe");
+    if (m_file == nullptr)
+    {
+        LOG_ERROR("BinaryLog::start cannot open {} errno:{}\n", inPath, errno);
+        return false;
+    }
+    ::fwrite(kMagic, 1, sizeof(kMagic), m_file);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bufferBytes = roundUpToPowerOfTwo(inBufferBytes);
+        m_sitesWritten = 0;  // every file carries its own site table
+    }
+    m_running = true;
+    m_thread = std::thread([this]() { persistLoop(); });
+    s_active.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+BinaryLog::~BinaryLog()
+{
+    stop();
+}
+
+void BinaryLog::stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+    s_active.store(false, std::memory_order_relaxed);
+    m_thread.join();
+    persistOnce();
+    ::fclose(m_file);
+    m_file = nullptr;
+}
+
+uint32_t BinaryLog::registerSite(std::atomic<uint32_t> &ioSiteId, const logdetail::LogSite &inSite, const char *inSignature)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t siteId = ioSiteId.load(std::memory_order_relaxed);
+    if (siteId == 0)
+    {
+        m_sites.push_back({inSite, inSignature});
+        siteId = static_cast<uint32_t>(m_sites.size());
+        ioSiteId.store(siteId, std::memory_order_release);
+    }
+    return siteId;
+}
+
+logdetail::StagingBuffer* BinaryLog::stagingBuffer()
+{
+    if (!t_bufferHolder.buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        t_bufferHolder.buffer = std::make_shared<logdetail::StagingBuffer>(
+            m_bufferBytes, static_cast<uint32_t>(::syscall(SYS_gettid)));
+        m_buffers.push_back(t_bufferHolder.buffer);
+    }
+    return t_bufferHolder.buffer.get();
+}
+
+void BinaryLog::persistLoop()
+{
+    while (m_running)
+    {
+        if (persistOnce() == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+size_t BinaryLog::persistOnce()
+{
+    std::vector<std::pair<std::shared_ptr<logdetail::StagingBuffer>, uint64_t>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Heads first: a record can only be visible once its site is registered
+        for (const auto &buffer : m_buffers)
+        {
+            pending.emplace_back(buffer, buffer->committed());
+        }
+        for (; m_sitesWritten < m_sites.size(); ++m_sitesWritten)
+        {
+            const SiteEntry &entry = m_sites[m_sitesWritten];
+            put(m_file, kSiteEntry);
+            put(m_file, static_cast<uint32_t>(m_sitesWritten + 1));
+            put(m_file, static_cast<int32_t>(entry.site.level));
+            put(m_file, static_cast<int32_t>(entry.site.line));
+            putString(m_file, entry.site.file);
+            putString(m_file, entry.site.format);
+            putString(m_file, entry.signature);
+        }
+    }
+
+    size_t written = 0;
+    for (const auto &[buffer, head] : pending)
+    {
+        const auto len = static_cast<uint32_t>(head - buffer->consumed());
+        if (len > 0)
+        {
+            put(m_file, kChunkEntry);
+            put(m_file, buffer->threadId());
+            put(m_file, len);
+            written += buffer->drain(head, [this](const char *data, size_t n) {
+                ::fwrite(data, 1, n, m_file);
+            });
+        }
+        const uint64_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            put(m_file, kDroppedEntry);
+            put(m_file, buffer->threadId());
+            put(m_file, dropped);
+            m_droppedTotal.fetch_add(dropped, std::memory_order_relaxed);
+        }
+    }
+    if (written > 0)
+    {
+        ::fflush(m_file);
+    }
+
+    // Forget rings of exited threads once they are empty
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [](const auto &buffer) {
+        return buffer->retired.load(std::memory_order_acquire) && buffer->committed() == buffer->consumed();
+    }), m_buffers.end());
+    return written;
+}
+
+bool BinaryLog::decode(FILE *inInput, FILE *outText)
+{
+    char magic[sizeof(kMagic)];
+    if (::fread(magic, 1, sizeof(magic), inInput) != sizeof(magic)
+        || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        return false;
+    }
+
+    struct DecodedSite
+    {
+        int level;
+        std::string format;
+        std::string signature;
+    };
+    std::unordered_map<uint32_t, DecodedSite> sites;
+    std::vector<char> chunk;
+    char tag = 0;
+    while (get(inInput, &tag))
+    {
+        if (tag == kSiteEntry)
+        {
+            uint32_t id = 0;
+            int32_t level = 0;
+            int32_t line = 0;
+            std::string file;
+            std::string format;
+            std::string signature;
+            if (!get(inInput, &id) || !get(inInput, &level) || !get(inInput, &line)
+                || !getString(inInput, &file) || !getString(inInput, &format) || !getString(inInput, &signature))
+            {
+                return false;
+            }
+            sites[id] = DecodedSite{level, std::move(format), std::move(signature)};
+        }
+        else if (tag == kChunkEntry)
+        {
+            uint32_t threadId = 0;
+            uint32_t len = 0;
+            if (!get(inInput, &threadId) || !get(inInput, &len))
+            {
+                return false;
+            }
+            chunk.resize(len);
+            if (len > 0 && ::fread(chunk.data(), 1, len, inInput) != len)
+            {
+                return false;
+            }
+
+            size_t pos = 0;
+            while (pos + kRecordHeaderSize <= len)
+            {
+                uint32_t siteId = 0;
+                uint32_t payloadLen = 0;
+                int64_t micros = 0;
+                std::memcpy(&siteId, chunk.data() + pos, sizeof(siteId));
+                std::memcpy(&payloadLen, chunk.data() + pos + 4, sizeof(payloadLen));
+                std::memcpy(&micros, chunk.data() + pos + 8, sizeof(micros));
+                pos += kRecordHeaderSize;
+                if (pos + payloadLen > len)
+                {
+                    return false;
+                }
+
+                logdetail::LogLine line;
+                const auto it = sites.find(siteId);
+                if (it == sites.end())
+                {
+                    line.append("<unknown call site>");
+                }
+                else
+                {
+                    const DecodedSite &entry = it->second;
+                    const std::string_view format = entry.format;
+                    PayloadReader reader(chunk.data() + pos, payloadLen);
+                    size_t formatPos = 0;
+                    for (char code : entry.signature)
+                    {
+                        if (logdetail::appendLiteral(line, format, formatPos))
+                        {
+                            appendDecodedArg(line, code, reader);
+                        }
+                    }
+                    logdetail::appendLiteral(line, format, formatPos);
+                }
+                pos += payloadLen;
+
+                std::string_view message = line.view();
+                if (!message.empty() && message.back() == '\n')
+                {
+                    message.remove_suffix(1);
+                }
+                const time_t seconds = static_cast<time_t>(micros / Timestamp::kMicroSecondsPerSecond);
+                tm tm_time;
+                localtime_r(&seconds, &tm_time);
+                const int level = it == sites.end() ? INFO : it->second.level;
+                std::fprintf(outText, "%s%4d/%02d/%02d %02d:%02d:%02d.%06d %u : %.*s\n",
+                             Logger::levelName(level),
+                             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
+                             static_cast<int>(micros % Timestamp::kMicroSecondsPerSecond),
+                             threadId, static_cast<int>(message.size()), message.data());
+            }
+        }
+        else if (tag == kDroppedEntry)
+        {
+            uint32_t threadId = 0;
+            uint64_t dropped = 0;
+            if (!get(inInput, &threadId) || !get(inInput, &dropped))
+            {
+                return false;
+            }
+            std::fprintf(outText, "[ERROR] thread %u dropped %lu records\n",
+                         threadId, static_cast<unsigned long>(dropped));
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace logdetail
+{
+
+/**
+ * @brief Static description of one LOG_* call site
+ */
+struct LogSite
+{
+    int level;
+    const char *file;
+    int line;
+    const char *format;
+};
+
+template <typename T>
+inline constexpr bool kUnsupportedBinaryArgument = false;
+
+/**
+ * @brief One-character code describing how an argument is stored in a record
+ * @details Integers keep their width (b/h/i/l signed, B/H/I/L unsigned), floats
+ *          are stored as double, strings as a 32-bit length plus bytes.
+ */
+template <typename T>
+constexpr char typeCode()
+{
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, bool>)
+        return '?';
+    else if constexpr (std::is_same_v<D, char>)
+        return 'c';
+    else if constexpr (std::is_integral_v<D>)
+    {
+        constexpr char kSigned[] = {'b', 'h', 0, 'i', 0, 0, 0, 'l'};
+        constexpr char kUnsigned[] = {'B', 'H', 0, 'I', 0, 0, 0, 'L'};
+        return std::is_signed_v<D> ? kSigned[sizeof(D) - 1] : kUnsigned[sizeof(D) - 1];
+    }
+    else if constexpr (std::is_floating_point_v<D>)
+        return 'd';
+    else if constexpr (std::is_enum_v<D>)
+        return typeCode<std::underlying_type_t<D>>();
+    else if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>
+                       || std::is_convertible_v<const T&, std::string_view>)
+        return 's';
+    else if constexpr (std::is_pointer_v<D> || std::is_null_pointer_v<D>)
+        return 'p';
+    else
+        static_assert(kUnsupportedBinaryArgument<T>, "unsupported LOG_* argument type");
+}
+
+template <typename... Args>
+struct Signature
+{
+    static constexpr char value[] = {typeCode<Args>()..., '\0'};
+};
+
+/**
+ * @brief Single-producer single-consumer byte ring owned by one logging thread
+ */
+class StagingBuffer : noncopyable
+{
+public:
+    StagingBuffer(size_t inCapacity, uint32_t inThreadId);
+
+    /**
+     * @brief Start a record of inLen bytes; false if the consumer is too far behind
+     */
+    bool reserve(size_t inLen) noexcept
+    {
+        const uint64_t tail = m_tail.load(std::memory_order_acquire);
+        return inLen <= m_capacity - (m_writePos - tail);
+    }
+
+    void write(const void *inData, size_t inLen) noexcept
+    {
+        const size_t offset = m_writePos & (m_capacity - 1);
+        const size_t first = std::min(inLen, m_capacity - offset);
+        std::memcpy(m_data.get() + offset, inData, first);
+        std::memcpy(m_data.get(), static_cast<const char*>(inData) + first, inLen - first);
+        m_writePos += inLen;
+    }
+
+    /**
+     * @brief Publish everything written since the last commit to the consumer
+     */
+    void commit() noexcept { m_head.store(m_writePos, std::memory_order_release); }
+
+    /**
+     * @brief Consumer side: pass committed bytes to inSink (as up to two pieces)
+     * @return Number of bytes consumed
+     */
+    template <typename Sink>
+    size_t drain(uint64_t inHead, Sink &&inSink)
+    {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t len = static_cast<size_t>(inHead - tail);
+        if (len == 0)
+        {
+            return 0;
+        }
+        const size_t offset = tail & (m_capacity - 1);
+        const size_t first = std::min(len, m_capacity - offset);
+        inSink(m_data.get() + offset, first);
+        if (len > first)
+        {
+            inSink(m_data.get(), len - first);
+        }
+        m_tail.store(inHead, std::memory_order_release);
+        return len;
+    }
+
+    [[nodiscard]] uint64_t committed() const noexcept { return m_head.load(std::memory_order_acquire); }
+    [[nodiscard]] uint64_t consumed() const noexcept { return m_tail.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint32_t threadId() const noexcept { return m_threadId; }
+
+    std::atomic<uint64_t> dropped{0};   ///< records rejected because the ring was full
+    std::atomic<bool> retired{false};   ///< owning thread exited
+
+private:
+    const size_t m_capacity;  // power of two
+    const uint32_t m_threadId;
+    std::unique_ptr<char[]> m_data;
+    uint64_t m_writePos{0};   // producer only
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+};
+
+}  // namespace logdetail
+
+/**
+ * @brief NanoLog-style binary log with deferred formatting
+ *
+ * While active, the LOG_* macros skip text formatting: each call site registers
+ * its format string once, and every record only copies the site id, a timestamp
+ * and the raw arguments into a per-thread ring buffer. A background thread
+ * appends the rings to a compact binary file, which decode() (or the
+ * BinaryLogDecoder tool) turns back into text. Records are dropped and counted
+ * when a thread's ring is full.
+ */
+class BinaryLog : noncopyable
+{
+public:
+    static BinaryLog& instance();
+
+    /**
+     * @brief Stops the persister at static destruction, so exiting while active persists and closes the file
+     */
+    ~BinaryLog();
+
+    /**
+     * @brief Open inPath and start the persister thread; LOG_* switch to binary records
+     * @param inBufferBytes Ring size per logging thread, rounded up to a power of two
+     */
+    bool start(const std::string &inPath, size_t inBufferBytes = 1 << 20);
+
+    /**
+     * @brief Switch LOG_* back to text, persist everything logged so far and close the file
+     * @note Called by LOG_FATAL before it exits; only the first of concurrent calls does the work
+     */
+    void stop();
+
+    [[nodiscard]] static bool active() noexcept { return s_active.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t droppedRecords() const noexcept
+    { return m_droppedTotal.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Append one record for a call site; called by the LOG_* macros
+     * @param ioSiteId Call site's id, 0 until it is registered
+     */
+    template <typename... Args>
+    void record(std::atomic<uint32_t> &ioSiteId, const logdetail::LogSite &inSite, const Args&... inArgs);
+
+    /**
+     * @brief Convert a binary log into text lines
+     * @return false if inInput is not a binary log or is truncated
+     */
+    static bool decode(FILE *inInput, FILE *outText);
+
+    static constexpr uint32_t kRecordHeaderSize = 16;  // site id, payload length, timestamp
+
+private:
+    BinaryLog() = default;
+
+    uint32_t registerSite(std::atomic<uint32_t> &ioSiteId, const logdetail::LogSite &inSite, const char *inSignature);
+    logdetail::StagingBuffer* stagingBuffer();
+    void persistLoop();
+
+    /**
+     * @brief Writes new call sites and all committed records; persister thread only
+     * @return Bytes of records written
+     */
+    size_t persistOnce();
+
+    template <typename T>
+    static size_t encodedSize(const T &inArg) noexcept;
+
+    template <typename T>
+    static void encode(logdetail::StagingBuffer &outBuffer, const T &inArg) noexcept;
+
+    struct SiteEntry
+    {
+        logdetail::LogSite site;
+        std::string signature;
+    };
+
+    inline static std::atomic<bool> s_active{false};
+
+    std::mutex m_mutex;
+    std::vector<SiteEntry> m_sites;   // index + 1 is the site id
+    std::vector<std::shared_ptr<logdetail::StagingBuffer>> m_buffers;
+    size_t m_bufferBytes{1 << 20};
+
+    FILE *m_file{nullptr};            // persister thread once started
+    size_t m_sitesWritten{0};         // persister thread only
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+    std::atomic<uint64_t> m_droppedTotal{0};
+};
+
+template <typename T>
+size_t BinaryLog::encodedSize(const T &inArg) noexcept
+{
+    using D = std::decay_t<T>;
+    constexpr char code = logdetail::typeCode<T>();
+    if constexpr (code == 's')
+    {
+        if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+        {
+            const char *text = inArg;
+            return sizeof(uint32_t) + (text != nullptr ? std::strlen(text) : 6);
+        }
+        else
+        {
+            return sizeof(uint32_t) + std::string_view(inArg).size();
+        }
+    }
+    else if constexpr (code == 'd' || code == 'p')
+    {
+        return 8;
+    }
+    else if constexpr (std::is_enum_v<D>)
+    {
+        return sizeof(std::underlying_type_t<D>);
+    }
+    else
+    {
+        return sizeof(D);
+    }
+}
+
+template <typename T>
+void BinaryLog::encode(logdetail::StagingBuffer &outBuffer, const T &inArg) noexcept
+{
+    using D = std::decay_t<T>;
+    constexpr char code = logdetail::typeCode<T>();
+    if constexpr (code == 's')
+    {
+        std::string_view text;
+        if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+        {
+            const char *chars = inArg;
+            text = chars != nullptr ? std::string_view(chars) : std::string_view("(null)");
+        }
+        else
+        {
+            text = std::string_view(inArg);
+        }
+        const auto len = static_cast<uint32_t>(text.size());
+        outBuffer.write(&len, sizeof(len));
+        outBuffer.write(text.data(), len);
+    }
+    else if constexpr (code == 'd')
+    {
+        const double value = static_cast<double>(inArg);
+        outBuffer.write(&value, sizeof(value));
+    }
+    else if constexpr (code == 'p')
+    {
+        const auto value = reinterpret_cast<uint64_t>(static_cast<const void*>(inArg));
+        outBuffer.write(&value, sizeof(value));
+    }
+    else
+    {
+        outBuffer.write(&inArg, sizeof(D));
+    }
+}
+
+template <typename... Args>
+void BinaryLog::record(std::atomic<uint32_t> &ioSiteId, const logdetail::LogSite &inSite, const Args&... inArgs)
+{
+    uint32_t siteId = ioSiteId.load(std::memory_order_acquire);
+    if (siteId == 0)
+    {
+        siteId = registerSite(ioSiteId, inSite, logdetail::Signature<Args...>::value);
+    }
+
+    logdetail::StagingBuffer *buffer = stagingBuffer();
+    const size_t payload = (size_t{0} + ... + encodedSize(inArgs));
+    if (!buffer->reserve(kRecordHeaderSize + payload))
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const auto payloadLen = static_cast<uint32_t>(payload);
+    const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    buffer->write(&siteId, sizeof(siteId));
+    buffer->write(&payloadLen, sizeof(payloadLen));
+    buffer->write(&now, sizeof(now));
+    (encode(*buffer, inArgs), ...);
+    buffer->commit();
+}
@@ -0,0 +1,52 @@
+#include "BlockPool.h"
+
+BlockPool::BlockPool(size_t inMaxCached)
+    : m_maxCached(inMaxCached)
+{
+    m_freeBlocks.reserve(inMaxCached);
+}
+
+BlockPool::~BlockPool()
+{
+    for (void *block : m_freeBlocks)
+    {
+        ::operator delete(block);
+    }
+}
+
+void* BlockPool::allocate(size_t inSize)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_blockSize == 0)
+        {
+            m_blockSize = inSize;
+        }
+        if (inSize == m_blockSize && !m_freeBlocks.empty())
+        {
+            void *block = m_freeBlocks.back();
+            m_freeBlocks.pop_back();
+            return block;
+        }
+    }
+    return ::operator new(inSize);
+}
+
+void BlockPool::deallocate(void *inBlock, size_t inSize) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (inSize == m_blockSize && m_freeBlocks.size() < m_maxCached)
+        {
+            m_freeBlocks.push_back(inBlock);
+            return;
+        }
+    }
+    ::operator delete(inBlock);
+}
+
+size_t BlockPool::cachedBlocks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_freeBlocks.size();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Free list of equally sized memory blocks
+ *
+ * The first allocation fixes the block size; later requests of that size are
+ * served from blocks released earlier, anything else falls through to
+ * ::operator new. Blocks may be released from any thread.
+ */
+class BlockPool : noncopyable
+{
+public:
+    /**
+     * @param inMaxCached Upper bound on released blocks kept for reuse
+     */
+    explicit BlockPool(size_t inMaxCached = 1024);
+    ~BlockPool();
+
+    [[nodiscard]] void* allocate(size_t inSize);
+    void deallocate(void *inBlock, size_t inSize) noexcept;
+
+    [[nodiscard]] size_t cachedBlocks() const;
+
+private:
+    mutable std::mutex m_mutex;
+    size_t m_blockSize{0};
+    const size_t m_maxCached;
+    std::vector<void*> m_freeBlocks;
+};
+
+/**
+ * @brief Allocator backed by a shared BlockPool, for use with std::allocate_shared
+ * @details allocate_shared rebinds the allocator to its control block type, so
+ *          the object and its reference counts share one recycled block. The pool
+ *          stays alive as long as any object allocated from it.
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                  "BlockPool blocks only have the default new alignment");
+
+    explicit PoolAllocator(std::shared_ptr<BlockPool> inPool) noexcept
+        : m_pool(std::move(inPool))
+    {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &inOther) noexcept
+        : m_pool(inOther.pool())
+    {}
+
+    T* allocate(size_t inCount)
+    {
+        if (inCount == 1)
+        {
+            return static_cast<T*>(m_pool->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(inCount * sizeof(T)));
+    }
+
+    void deallocate(T *inPtr, size_t inCount) noexcept
+    {
+        if (inCount == 1)
+        {
+            m_pool->deallocate(inPtr, sizeof(T));
+        }
+        else
+        {
+            ::operator delete(inPtr);
+        }
+    }
+
+    [[nodiscard]] const std::shared_ptr<BlockPool>& pool() const noexcept { return m_pool; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &inOther) const noexcept { return m_pool == inOther.pool(); }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &inOther) const noexcept { return m_pool != inOther.pool(); }
+
+private:
+    std::shared_ptr<BlockPool> m_pool;
+};
@@ -1,23 +1,348 @@
 #include "Buffer.h"
+#include "Probes.h"
 
 #include <array>
+#include <cstdlib>
 #include <system_error>
 #include <sys/uio.h>
 #include <unistd.h>
 
-ssize_t Buffer::readFd(int inFd, int* inSaveErrno)
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MUDUO_BUFFER_X86_SIMD 1
+#endif
+
+namespace
+{
+constexpr char kCRLF[] = "\r\n";
+
+/**
+ * @brief Set of search kernels selected once at startup
+ * @details All kernels search [inBegin, inEnd) and return nullptr when nothing matches
+ */
+struct SearchKernels
+{
+    const char* (*findByte)(const char *inBegin, const char *inEnd, char inByte);
+    const char* (*findCRLF)(const char *inBegin, const char *inEnd);
+    const char* (*findSubstr)(const char *inBegin, const char *inEnd, const char *inNeedle, size_t inLen);
+    const char* (*findAny)(const char *inBegin, const char *inEnd, const char *inSet, size_t inSetLen);
+};
+
+// Delimiter sets larger than this fall back to the scalar lookup table
+constexpr size_t kMaxSimdDelimiters = 8;
+
+const char* findByteScalar(const char *inBegin, const char *inEnd, char inByte)
+{
+    return static_cast<const char*>(::memchr(inBegin, inByte, inEnd - inBegin));
+}
+
+const char* findSubstrScalar(const char *inBegin, const char *inEnd, const char *inNeedle, size_t inLen)
+{
+    const char *match = std::search(inBegin, inEnd, inNeedle, inNeedle + inLen);
+    return match == inEnd ? nullptr : match;
+}
+
+const char* findCRLFScalar(const char *inBegin, const char *inEnd)
+{
+    return findSubstrScalar(inBegin, inEnd, kCRLF, 2);
+}
+
+const char* findAnyScalar(const char *inBegin, const char *inEnd, const char *inSet, size_t inSetLen)
+{
+    std::array<bool, 256> table{};
+    for (size_t i = 0; i < inSetLen; ++i)
+    {
+        table[static_cast<unsigned char>(inSet[i])] = true;
+    }
+    for (const char *p = inBegin; p < inEnd; ++p)
+    {
+        if (table[static_cast<unsigned char>(*p)])
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef MUDUO_BUFFER_X86_SIMD
+
+/**
+ * SSE2 kernels (baseline on x86-64). Each processes 16 bytes per step and
+ * hands the tail to the scalar kernel.
+ */
+__attribute__((target("sse2")))
+const char* findByteSse2(const char *inBegin, const char *inEnd, char inByte)
+{
+    const __m128i needle = _mm_set1_epi8(inByte);
+    const char *p = inBegin;
+    for (; inEnd - p >= 16; p += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteScalar(p, inEnd, inByte);
+}
+
+__attribute__((target("sse2")))
+const char* findCRLFSse2(const char *inBegin, const char *inEnd)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char *p = inBegin;
+    for (; inEnd - p >= 17; p += 16)
+    {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        const unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, cr), _mm_cmpeq_epi8(second, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFScalar(p, inEnd);
+}
+
+// Compares the first and last needle bytes in parallel and verifies candidates with memcmp
+__attribute__((target("sse2")))
+const char* findSubstrSse2(const char *inBegin, const char *inEnd, const char *inNeedle, size_t inLen)
+{
+    const __m128i first = _mm_set1_epi8(inNeedle[0]);
+    const __m128i last = _mm_set1_epi8(inNeedle[inLen - 1]);
+    const char *p = inBegin;
+    for (; inEnd - p >= static_cast<ptrdiff_t>(inLen - 1 + 16); p += 16)
+    {
+        const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + inLen - 1));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        while (mask != 0)
+        {
+            const int bit = __builtin_ctz(mask);
+            if (::memcmp(p + bit + 1, inNeedle + 1, inLen - 2) == 0)
+            {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSubstrScalar(p, inEnd, inNeedle, inLen);
+}
+
+__attribute__((target("sse2")))
+const char* findAnySse2(const char *inBegin, const char *inEnd, const char *inSet, size_t inSetLen)
+{
+    __m128i needles[kMaxSimdDelimiters];
+    for (size_t i = 0; i < inSetLen; ++i)
+    {
+        needles[i] = _mm_set1_epi8(inSet[i]);
+    }
+    const char *p = inBegin;
+    for (; inEnd - p >= 16; p += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_setzero_si128();
+        for (size_t i = 0; i < inSetLen; ++i)
+        {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+        }
+        const unsigned mask = _mm_movemask_epi8(hits);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findAnyScalar(p, inEnd, inSet, inSetLen);
+}
+
+/**
+ * AVX2 kernels, 32 bytes per step. Only called when the CPU reports AVX2 support.
+ */
+__attribute__((target("avx2")))
+const char* findByteAvx2(const char *inBegin, const char *inEnd, char inByte)
+{
+    const __m256i needle = _mm256_set1_epi8(inByte);
+    const char *p = inBegin;
+    for (; inEnd - p >= 32; p += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteSse2(p, inEnd, inByte);
+}
+
+__attribute__((target("avx2")))
+const char* findCRLFAvx2(const char *inBegin, const char *inEnd)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char *p = inBegin;
+    for (; inEnd - p >= 33; p += 32)
+    {
+        const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        const unsigned mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, cr), _mm256_cmpeq_epi8(second, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFSse2(p, inEnd);
+}
+
+__attribute__((target("avx2")))
+const char* findSubstrAvx2(const char *inBegin, const char *inEnd, const char *inNeedle, size_t inLen)
+{
+    const __m256i first = _mm256_set1_epi8(inNeedle[0]);
+    const __m256i last = _mm256_set1_epi8(inNeedle[inLen - 1]);
+    const char *p = inBegin;
+    for (; inEnd - p >= static_cast<ptrdiff_t>(inLen - 1 + 32); p += 32)
+    {
+        const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + inLen - 1));
+        unsigned mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask != 0)
+        {
+            const int bit = __builtin_ctz(mask);
+            if (::memcmp(p + bit + 1, inNeedle + 1, inLen - 2) == 0)
+            {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSubstrSse2(p, inEnd, inNeedle, inLen);
+}
+
+__attribute__((target("avx2")))
+const char* findAnyAvx2(const char *inBegin, const char *inEnd, const char *inSet, size_t inSetLen)
+{
+    __m256i needles[kMaxSimdDelimiters];
+    for (size_t i = 0; i < inSetLen; ++i)
+    {
+        needles[i] = _mm256_set1_epi8(inSet[i]);
+    }
+    const char *p = inBegin;
+    for (; inEnd - p >= 32; p += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hits = _mm256_setzero_si256();
+        for (size_t i = 0; i < inSetLen; ++i)
+        {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+        }
+        const unsigned mask = _mm256_movemask_epi8(hits);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findAnySse2(p, inEnd, inSet, inSetLen);
+}
+
+#endif  // MUDUO_BUFFER_X86_SIMD
+
+SearchKernels selectKernels()
+{
+    const SearchKernels scalar{findByteScalar, findCRLFScalar, findSubstrScalar, findAnyScalar};
+#ifdef MUDUO_BUFFER_X86_SIMD
+    const SearchKernels sse2{findByteSse2, findCRLFSse2, findSubstrSse2, findAnySse2};
+    const SearchKernels avx2{findByteAvx2, findCRLFAvx2, findSubstrAvx2, findAnyAvx2};
+
+    const char *forced = ::getenv("MUDUO_BUFFER_SIMD");
+    const std::string_view choice = forced ? forced : "";
+    if (choice == "scalar")
+    {
+        return scalar;
+    }
+    __builtin_cpu_init();
+    const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (choice == "sse2" || !hasAvx2)
+    {
+        return __builtin_cpu_supports("sse2") ? sse2 : scalar;
+    }
+    return avx2;
+#else
+    return scalar;
+#endif
+}
+
+const SearchKernels& searchKernels()
+{
+    static const SearchKernels kernels = selectKernels();
+    return kernels;
+}
+}  // namespace
+
+const char* Buffer::findCRLF(const char *inStart) const
+{
+    return searchKernels().findCRLF(inStart, beginWrite());
+}
+
+const char* Buffer::findEOL(const char *inStart) const
+{
+    return searchKernels().findByte(inStart, beginWrite(), '\n');
+}
+
+const char* Buffer::find(std::string_view inDelimiter, const char *inStart) const
+{
+    const char *end = beginWrite();
+    if (inDelimiter.empty())
+    {
+        return inStart;
+    }
+    if (static_cast<size_t>(end - inStart) < inDelimiter.size())
+    {
+        return nullptr;
+    }
+    if (inDelimiter.size() == 1)
+    {
+        return searchKernels().findByte(inStart, end, inDelimiter[0]);
+    }
+    return searchKernels().findSubstr(inStart, end, inDelimiter.data(), inDelimiter.size());
+}
+
+const char* Buffer::findAny(std::string_view inDelimiters, const char *inStart) const
+{
+    const char *end = beginWrite();
+    if (inDelimiters.empty())
+    {
+        return nullptr;
+    }
+    if (inDelimiters.size() == 1)
+    {
+        return searchKernels().findByte(inStart, end, inDelimiters[0]);
+    }
+    if (inDelimiters.size() > kMaxSimdDelimiters)
+    {
+        return findAnyScalar(inStart, end, inDelimiters.data(), inDelimiters.size());
+    }
+    return searchKernels().findAny(inStart, end, inDelimiters.data(), inDelimiters.size());
+}
+
+ssize_t Buffer::readFd(int inFd, int* inSaveErrno, size_t inMaxBytes)
 {
-    static constexpr size_t kExtraBufSize = 65536;  // 64KB stack buffer
     std::array<char, kExtraBufSize> extraBuf{};
     
+    const auto writable = std::min(writableBytes(), inMaxBytes);
     std::array<struct iovec, 2> vec{{
-        { begin() + m_writerIndex, writableBytes() },  // buffer space
-        { extraBuf.data(), extraBuf.size() }         // stack space
+        { begin() + m_writerIndex, writable },  // buffer space
+        { extraBuf.data(), std::min(extraBuf.size(), inMaxBytes - writable) }  // stack space
     }};
     
-    const auto writable = writableBytes();
-    const int iovcnt = (writable < extraBuf.size()) ? 2 : 1;
+    const int iovcnt = (writable < extraBuf.size() && vec[1].iov_len > 0) ? 2 : 1;
     const auto n = ::readv(inFd, vec.data(), iovcnt);
+    MUDUO_PROBE2(buffer__read, inFd, n);
     if (n < 0)
     {
         *inSaveErrno = errno;
@@ -36,22 +361,27 @@ ssize_t Buffer::readFd(int inFd, int* inSaveErrno)
     return n;
 }
 
+size_t Buffer::readFdCapacity(size_t inMaxBytes) const
+{
+    const auto writable = std::min(writableBytes(), inMaxBytes);
+    // readFd() only adds the stack buffer while the buffer itself has less room
+    return writable < kExtraBufSize ? writable + std::min(kExtraBufSize, inMaxBytes - writable) : writable;
+}
+
 /**
  * @brief Write buffer contents to a file descriptor
  * @details Performs a single write operation for all readable data
  */
-ssize_t Buffer::writeFd(int inFd, int* inSaveErrno)
+ssize_t Buffer::writeFd(int inFd, int* inSaveErrno, size_t inMaxBytes)
 {
-    const auto readable = readableBytes();
+    const auto readable = std::min(readableBytes(), inMaxBytes);
     if (readable == 0) { return 0; }
     
-    if (const auto n = ::write(inFd, peek(), readable); n < 0)
+    const auto n = ::write(inFd, peek(), readable);
+    MUDUO_PROBE2(buffer__write, inFd, n);
+    if (n < 0)
     {
         *inSaveErrno = errno;
-        return n;
-    }
-    else
-    {
-        return n;
     }
+    return n;
 }
\ No newline at end of file
@@ -2,7 +2,11 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
 
 /**
  * @brief Network library underlying buffer implementation
@@ -13,6 +17,7 @@ class Buffer
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
+    static constexpr size_t kExtraBufSize = 65536;  // Stack space readFd() reads into beyond writableBytes()
 
     /**
      * @brief Constructs a buffer with specified initial size
@@ -133,6 +138,128 @@ public:
         m_writerIndex += inLen;
     }
 
+    /**
+     * @brief Reserve a writable region at the end of the buffer
+     * @param len Minimum number of bytes the caller intends to write
+     * @return Pointer to at least len writable bytes
+     * @details The region becomes readable only after hasWritten(); the pointer is
+     *          invalidated by any later call that may grow the buffer
+     */
+    char* reserve(size_t inLen)
+    {
+        ensureWriteableBytes(inLen);
+        return beginWrite();
+    }
+
+    /**
+     * @brief Commit bytes written directly into the region returned by reserve()/beginWrite()
+     * @param len Number of bytes actually written, must not exceed writableBytes()
+     */
+    void hasWritten(size_t inLen)
+    {
+        m_writerIndex += inLen;
+    }
+
+    /**
+     * @brief Append integers in network byte order
+     */
+    void appendInt64(int64_t inX)
+    {
+        const uint64_t be64 = htobe64(static_cast<uint64_t>(inX));
+        append(reinterpret_cast<const char*>(&be64), sizeof be64);
+    }
+
+    void appendInt32(int32_t inX)
+    {
+        const uint32_t be32 = htobe32(static_cast<uint32_t>(inX));
+        append(reinterpret_cast<const char*>(&be32), sizeof be32);
+    }
+
+    void appendInt16(int16_t inX)
+    {
+        const uint16_t be16 = htobe16(static_cast<uint16_t>(inX));
+        append(reinterpret_cast<const char*>(&be16), sizeof be16);
+    }
+
+    void appendInt8(int8_t inX)
+    {
+        append(reinterpret_cast<const char*>(&inX), sizeof inX);
+    }
+
+    /**
+     * @brief Peek integers stored in network byte order without consuming them
+     * @details Requires readableBytes() >= sizeof the integer
+     */
+    int64_t peekInt64() const
+    {
+        uint64_t be64 = 0;
+        ::memcpy(&be64, peek(), sizeof be64);
+        return static_cast<int64_t>(be64toh(be64));
+    }
+
+    int32_t peekInt32() const
+    {
+        uint32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return static_cast<int32_t>(be32toh(be32));
+    }
+
+    int16_t peekInt16() const
+    {
+        uint16_t be16 = 0;
+        ::memcpy(&be16, peek(), sizeof be16);
+        return static_cast<int16_t>(be16toh(be16));
+    }
+
+    int8_t peekInt8() const
+    {
+        return static_cast<int8_t>(*peek());
+    }
+
+    /**
+     * @brief Read (peek and retrieve) integers stored in network byte order
+     */
+    int64_t readInt64() { const int64_t result = peekInt64(); retrieve(sizeof result); return result; }
+    int32_t readInt32() { const int32_t result = peekInt32(); retrieve(sizeof result); return result; }
+    int16_t readInt16() { const int16_t result = peekInt16(); retrieve(sizeof result); return result; }
+    int8_t readInt8() { const int8_t result = peekInt8(); retrieve(sizeof result); return result; }
+
+    /**
+     * @brief Find the first "\r\n" in the readable region
+     * @param start Position inside [peek(), beginWrite()] to start searching from
+     * @return Pointer to the '\r' of the first CRLF, nullptr if not found
+     * @details Searches are vectorized (SSE2/AVX2, selected at runtime); set
+     *          MUDUO_BUFFER_SIMD=scalar|sse2|avx2 to force an implementation
+     */
+    const char* findCRLF() const { return findCRLF(peek()); }
+    const char* findCRLF(const char *inStart) const;
+
+    /**
+     * @brief Find the first '\n' in the readable region
+     * @param start Position inside [peek(), beginWrite()] to start searching from
+     * @return Pointer to the first '\n', nullptr if not found
+     */
+    const char* findEOL() const { return findEOL(peek()); }
+    const char* findEOL(const char *inStart) const;
+
+    /**
+     * @brief Find the first occurrence of a delimiter in the readable region
+     * @param delimiter Byte sequence to search for; an empty delimiter matches at start
+     * @param start Position inside [peek(), beginWrite()] to start searching from
+     * @return Pointer to the beginning of the match, nullptr if not found
+     */
+    const char* find(std::string_view inDelimiter) const { return find(inDelimiter, peek()); }
+    const char* find(std::string_view inDelimiter, const char *inStart) const;
+
+    /**
+     * @brief Find the first byte that equals any of the given delimiters
+     * @param delimiters Set of single-byte delimiters, e.g. ":\r\n" for header parsing
+     * @param start Position inside [peek(), beginWrite()] to start searching from
+     * @return Pointer to the first matching byte, nullptr if not found
+     */
+    const char* findAny(std::string_view inDelimiters) const { return findAny(inDelimiters, peek()); }
+    const char* findAny(std::string_view inDelimiters, const char *inStart) const;
+
     char* beginWrite()
     {
         return begin() + m_writerIndex;
@@ -147,17 +274,25 @@ public:
      * @brief Read data from file descriptor
      * @param fd File descriptor to read from
      * @param saveErrno Pointer to store error number
+     * @param maxBytes Upper bound on the bytes read in this call
      * @return Number of bytes read, -1 on error
      */
-    ssize_t readFd(int inFd, int* inSaveErrno);
+    ssize_t readFd(int inFd, int* inSaveErrno, size_t inMaxBytes = static_cast<size_t>(-1));
+
+    /**
+     * @brief Most bytes a single readFd() with the same maxBytes can read right now
+     * @details A read that returns less has drained the file descriptor
+     */
+    size_t readFdCapacity(size_t inMaxBytes = static_cast<size_t>(-1)) const;
 
     /**
      * @brief Write data to file descriptor
      * @param fd File descriptor to write to
      * @param saveErrno Pointer to store error number
+     * @param maxBytes Upper bound on the bytes written in this call
      * @return Number of bytes written, -1 on error
      */
-    ssize_t writeFd(int inFd, int* inSaveErrno);
+    ssize_t writeFd(int inFd, int* inSaveErrno, size_t inMaxBytes = static_cast<size_t>(-1));
 private:
     char* begin()
     {
@@ -15,3 +15,4 @@ using MessageCallback = std::function<void (const TcpConnectionPtr&,
                                         Buffer*,
                                         Timestamp)>;
 using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
+using LowWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
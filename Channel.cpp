@@ -1,6 +1,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Probes.h"
 
 #include <sys/epoll.h>
 
@@ -37,6 +38,11 @@ void Channel::remove()
 
 void Channel::handleEvent(Timestamp inReceiveTime)
 {
+    // A callback may close the connection and destroy this channel once the tie guard
+    // is released, so the end probe reports copies taken before dispatch
+    [[maybe_unused]] const int fd = m_fd;
+    [[maybe_unused]] const int revents = m_revents;
+    MUDUO_PROBE2(channel__begin, fd, revents);
     if (m_tied)
     {
         std::shared_ptr<void> guard = m_tie.lock();
@@ -49,11 +55,12 @@ void Channel::handleEvent(Timestamp inReceiveTime)
     {
         handleEventWithGuard(inReceiveTime);
     }
+    MUDUO_PROBE2(channel__end, fd, revents);
 }
 
 void Channel::handleEventWithGuard(Timestamp inReceiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", m_revents);
+    LOG_DEBUG("channel handleEvent revents:{}\n", m_revents);
 
     if ((m_revents & EPOLLHUP) && !(m_revents & EPOLLIN))
     {
@@ -3,6 +3,7 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -157,6 +158,23 @@ public:
      */
     EventLoop* ownerLoop() { return m_loop; }
 
+    /**
+     * @brief Id of the connection owning this channel, reported by LoopWatchdog; 0 if none
+     */
+    void setOwnerId(uint64_t inId) { m_ownerId = inId; }
+    uint64_t ownerId() const { return m_ownerId; }
+
+    /**
+     * @brief Bookkeeping of EventLoop::queueReadyChannel(), loop thread only
+     *
+     * readyQueued() is set while the channel waits in the ready list; activeIteration()
+     * is the loop iteration in which it was last put on the active list.
+     */
+    bool readyQueued() const { return m_readyQueued; }
+    void setReadyQueued(bool inQueued) { m_readyQueued = inQueued; }
+    uint64_t activeIteration() const { return m_activeIteration; }
+    void setActiveIteration(uint64_t inIteration) { m_activeIteration = inIteration; }
+
 private:
     /**
      * @brief Updates channel's events in EventLoop
@@ -180,6 +198,9 @@ private:
     int m_channelStatus;            // Current status in the event system
     std::weak_ptr<void> m_tie;      // Weak pointer to the owner object
     bool m_tied;                    // Whether the channel is tied to an owner
+    uint64_t m_ownerId{0};          // TcpConnection id, for stall reports
+    bool m_readyQueued{false};      // In EventLoop's ready list
+    uint64_t m_activeIteration{0};  // EventLoop iteration that last dispatched it, 0 = never
 
     // Event callbacks
     ReadEventCallback m_readCallback;
@@ -0,0 +1,32 @@
+#pragma once
+
+class TcpConnection;
+
+/**
+ * @brief Intrusive handle that keeps a TcpConnection alive on its loop thread
+ *
+ * Loop-internal paths (queued functors, flushes, throttle timers, the write
+ * scheduler) hold one of these instead of a TcpConnectionPtr, so taking and
+ * dropping a reference is a plain increment instead of an atomic one. While
+ * any handle exists, or while the connection is established, the connection
+ * holds a TcpConnectionPtr to itself; it is dropped once the connection has
+ * been destroyed and the last handle is gone.
+ *
+ * @note Create, copy and destroy only on the connection's loop thread
+ */
+class ConnectionRef
+{
+public:
+    explicit ConnectionRef(TcpConnection *inConn);
+    ConnectionRef(const ConnectionRef &inOther) noexcept;
+    ConnectionRef(ConnectionRef &&inOther) noexcept : m_conn(inOther.m_conn) { inOther.m_conn = nullptr; }
+    ConnectionRef& operator=(const ConnectionRef&) = delete;
+    ConnectionRef& operator=(ConnectionRef&&) = delete;
+    ~ConnectionRef();
+
+    [[nodiscard]] TcpConnection* get() const noexcept { return m_conn; }
+    TcpConnection* operator->() const noexcept { return m_conn; }
+
+private:
+    TcpConnection *m_conn;
+};
@@ -18,7 +18,7 @@ EPollPoller::EPollPoller(EventLoop *inLoop)
 {
     if (m_epollfd < 0)
     {
-        LOG_FATAL("epoll_create error:%d \n", errno);
+        LOG_FATAL("epoll_create error:{} \n", errno);
     }
 }
 
@@ -41,18 +41,18 @@ void EPollPoller::update(int operation, Channel *inChannel)
     {
         if (operation == EPOLL_CTL_DEL)
         {
-            LOG_ERROR("epoll_ctl del error:%d\n", errno);
+            LOG_ERROR("epoll_ctl del error:{}\n", errno);
         }
         else
         {
-            LOG_FATAL("epoll_ctl add/mod error:%d\n", errno);
+            LOG_FATAL("epoll_ctl add/mod error:{}\n", errno);
         }
     }
 }
 
 Timestamp EPollPoller::poll(int inTimeoutMs, ChannelList *outActiveChannels)
 {
-    LOG_INFO("func=%s => fd total count:%lu \n", __func__, m_channels.size());
+    LOG_DEBUG("func={} => fd total count:{} \n", __func__, m_channels.size());
 
     int numEvents = ::epoll_wait(m_epollfd, &*m_events.begin(), static_cast<int>(m_events.size()), inTimeoutMs);
     // Save errno immediately after system call as it might be modified by subsequent operations
@@ -61,7 +61,7 @@ Timestamp EPollPoller::poll(int inTimeoutMs, ChannelList *outActiveChannels)
 
     if (numEvents > 0)
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_DEBUG("{} events happened \n", numEvents);
         fillActiveChannels(numEvents, outActiveChannels);
         if (static_cast<size_t>(numEvents) == m_events.size())
         {
@@ -70,7 +70,7 @@ Timestamp EPollPoller::poll(int inTimeoutMs, ChannelList *outActiveChannels)
     }
     else if (numEvents == 0)
     {
-        LOG_DEBUG("%s timeout! \n", __func__);
+        LOG_DEBUG("{} timeout! \n", __func__);
     }
     else  // numEvents < 0 indicates an error in epoll_wait
     {
@@ -80,7 +80,7 @@ Timestamp EPollPoller::poll(int inTimeoutMs, ChannelList *outActiveChannels)
         {
             // Restore the original errno before logging as the log function might change it
             errno = saveErrno;
-            LOG_ERROR("EPollPoller::poll() error: %d: %s", errno, strerror(errno));
+            LOG_ERROR("EPollPoller::poll() error: {}: {}", errno, strerror(errno));
         }
     }
     // Always return current timestamp regardless of whether we got events or errors
@@ -90,7 +90,7 @@ Timestamp EPollPoller::poll(int inTimeoutMs, ChannelList *outActiveChannels)
 void EPollPoller::updateChannel(Channel *inOutChannel)
 {
     const int status = inOutChannel->getChannelStatus();
-    LOG_INFO("func=%s => fd=%d events=%d status=%d \n", __func__, inOutChannel->getFd(), inOutChannel->getEvents(), status);
+    LOG_DEBUG("func={} => fd={} events={} status={} \n", __func__, inOutChannel->getFd(), inOutChannel->getEvents(), status);
 
     if (status == kStatusNew || status == kStatusDeleted)
     {
@@ -99,6 +99,12 @@ void EPollPoller::updateChannel(Channel *inOutChannel)
             int fd = inOutChannel->getFd();
             m_channels[fd] = inOutChannel;
         }
+        // Re-adding with no interest would still report EPOLLHUP/EPOLLERR for the fd
+        if (inOutChannel->isNoneEvent())
+        {
+            inOutChannel->setChannelStatus(kStatusDeleted);
+            return;
+        }
 
         inOutChannel->setChannelStatus(kStatusAdded);
         update(EPOLL_CTL_ADD, inOutChannel);
@@ -124,7 +130,7 @@ void EPollPoller::removeChannel(Channel *inOutChannel)
     int fd = inOutChannel->getFd();
     m_channels.erase(fd);
 
-    LOG_INFO("func=%s => fd=%d\n", __func__, fd);
+    LOG_INFO("func={} => fd={}\n", __func__, fd);
     
     int status = inOutChannel->getChannelStatus();
     if (status == kStatusAdded)
@@ -2,12 +2,15 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "Probes.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
+#include <sys/epoll.h>
 
 // Prevent creating multiple EventLoops in one thread using thread_local
 __thread EventLoop *t_loopInThisThread = nullptr;
@@ -29,7 +32,7 @@ static int createEventfd()
     int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if (evtfd < 0)
     {
-        LOG_FATAL("eventfd error:%d \n", errno);
+        LOG_FATAL("eventfd error:{} \n", errno);
     }
     return evtfd;
 }
@@ -39,14 +42,15 @@ EventLoop::EventLoop()
     , m_quit(false)
     , m_threadId(::syscall(SYS_gettid))
     , m_poller(Poller::newDefaultPoller(this))
+    , m_timerQueue(new TimerQueue(this))
     , m_wakeupFd(createEventfd())
     , m_wakeupChannel(new Channel(this, m_wakeupFd))
     , m_callingPendingFunctors(false)
 {
-    LOG_DEBUG("EventLoop created %p in thread %d \n", this, m_threadId);
+    LOG_DEBUG("EventLoop created {} in thread {} \n", this, m_threadId);
     if (t_loopInThisThread)
     {
-        LOG_FATAL("Another EventLoop %p exists in this thread %d \n", t_loopInThisThread, m_threadId);
+        LOG_FATAL("Another EventLoop {} exists in this thread {} \n", t_loopInThisThread, m_threadId);
     }
     else
     {
@@ -72,17 +76,74 @@ void EventLoop::loop()
     m_looping = true;
     m_quit = false;
 
-    LOG_INFO("EventLoop %p start looping \n", this);
+    LOG_INFO("EventLoop {} start looping \n", this);
 
     while(!m_quit)
     {
+        ++m_iteration;
         m_activeChannels.clear();
         // Monitor two types of fd: client fd and wakeup fd
-        m_pollReturnTime = m_poller->poll(kPollTimeMs, &m_activeChannels);
+        // Connections still waiting for read or write budget must be served without blocking
+        // as must functors carried over by the time budget and idle functors
+        const bool writesPending = m_writeScheduler && m_writeScheduler->hasPending();
+        const bool readsPending = !m_readyChannels.empty();
+        const bool functorsPending = m_functorsCarriedOver || m_idlePending;
+        const bool metrics = m_metricsEnabled.load(std::memory_order_relaxed);
+        const int64_t stallThreshold = m_stallThresholdNs.load(std::memory_order_relaxed);
+        m_watched = stallThreshold > 0;
+        const int timeoutMs = writesPending || readsPending || functorsPending ? 0 : kPollTimeMs;
+        const bool perf = m_perfCountersEnabled.load(std::memory_order_relaxed);
+        if (perf != (m_perfCounters != nullptr))
+        {
+            updatePerfCounters(perf);
+        }
+        if (m_perfCounters)
+        {
+            m_metrics.recordPerfDispatch(m_perfCounters->lap(), m_perfEvents);
+        }
+        const int64_t pollStart = metrics ? monotonicNanos() : 0;
+        MUDUO_PROBE2(poll__entry, this, timeoutMs);
+        m_pollReturnTime = m_poller->poll(timeoutMs, &m_activeChannels);
+        MUDUO_PROBE2(poll__exit, this, m_activeChannels.size());
+        if (m_perfCounters)
+        {
+            m_metrics.recordPerfPoll(m_perfCounters->lap());
+        }
+        const int64_t pollEnd = metrics || m_watched ? monotonicNanos() : 0;
+        if (metrics)
+        {
+            m_metrics.recordPoll(pollEnd - pollStart, m_activeChannels.size());
+        }
+        if (m_watched)
+        {
+            m_heartbeat.phase.store(LoopHeartbeat::kDispatching, std::memory_order_relaxed);
+            m_heartbeat.busySince.store(pollEnd, std::memory_order_relaxed);
+        }
+        if (readsPending)
+        {
+            addReadyChannels();
+        }
+        const bool pollIdle = m_activeChannels.empty();
+        m_perfEvents = m_activeChannels.size();
         for (Channel *channel : m_activeChannels)
         {
             // Poller monitors which channels have events, reports to EventLoop, and notifies channels to handle corresponding events
-            channel->handleEvent(m_pollReturnTime);
+            if (m_watched)
+            {
+                m_heartbeat.fd.store(channel->getFd(), std::memory_order_relaxed);
+                m_heartbeat.ownerId.store(channel->ownerId(), std::memory_order_relaxed);
+                m_heartbeat.callback.store(nullptr, std::memory_order_relaxed);
+            }
+            if (metrics)
+            {
+                const int64_t start = monotonicNanos();
+                channel->handleEvent(m_pollReturnTime);
+                m_metrics.recordDispatch(monotonicNanos() - start);
+            }
+            else
+            {
+                channel->handleEvent(m_pollReturnTime);
+            }
         }
         // Execute callback operations that need to be processed in the current EventLoop
         /**
@@ -90,10 +151,14 @@ void EventLoop::loop()
          * mainLoop pre-registers a callback cb (to be executed by subloop), after waking up subloop,
          * execute the method below to perform the cb operation previously registered by mainloop
          */ 
-        doPendingFunctors();
+        doPendingFunctors(pollIdle, metrics);
+        if (m_watched)
+        {
+            finishWatchedIteration(pollEnd, stallThreshold);
+        }
     }
 
-    LOG_INFO("EventLoop %p stop looping. \n", this);
+    LOG_INFO("EventLoop {} stop looping. \n", this);
     m_looping = false;
 }
 
@@ -125,11 +190,24 @@ void EventLoop::runInLoop(Functor inCallback)
     }
 }
 
-void EventLoop::queueInLoop(Functor inCallback)
+void EventLoop::queueInLoop(Functor inCallback, Priority inPriority)
 {
+    MUDUO_PROBE2(queue, this, static_cast<int>(inPriority));
     {
         std::unique_lock<std::mutex> lock(m_mutex);
-        m_pendingFunctors.emplace_back(inCallback);
+        switch (inPriority)
+        {
+        case Priority::Urgent:
+            m_urgentFunctors.emplace_back(std::move(inCallback));
+            break;
+        case Priority::Normal:
+            m_pendingFunctors.emplace_back(std::move(inCallback));
+            break;
+        case Priority::Idle:
+            m_idleFunctors.emplace_back(std::move(inCallback));
+            m_idlePending = true;
+            break;
+        }
     }
 
     // Wake up the loop thread that needs to execute the above callback operations
@@ -140,23 +218,58 @@ void EventLoop::queueInLoop(Functor inCallback)
     }
 }
 
+void EventLoop::enableWriteScheduler(size_t inBytesPerIteration, size_t inQuantum)
+{
+    m_writeScheduler = std::make_unique<WriteScheduler>(inBytesPerIteration, inQuantum);
+}
+
+TimerId EventLoop::runAt(Timestamp inTime, Functor inCallback)
+{
+    return m_timerQueue->addTimer(std::move(inCallback), inTime, 0.0);
+}
+
+TimerId EventLoop::runAfter(double inDelay, Functor inCallback)
+{
+    return runAt(addTime(Timestamp::now(), inDelay), std::move(inCallback));
+}
+
+TimerId EventLoop::runEvery(double inInterval, Functor inCallback)
+{
+    return m_timerQueue->addTimer(std::move(inCallback), addTime(Timestamp::now(), inInterval), inInterval);
+}
+
+void EventLoop::cancel(TimerId inTimerId)
+{
+    m_timerQueue->cancel(inTimerId);
+}
+
+void EventLoop::queueFlush(Functor inCallback)
+{
+    m_pendingFlushes.emplace_back(std::move(inCallback));
+}
+
 void EventLoop::handleRead()
 {
   uint64_t one = 1;
   ssize_t n = read(m_wakeupFd, &one, sizeof one);
   if (n != sizeof one)
   {
-    LOG_ERROR("EventLoop::handleRead() reads %lu bytes instead of 8", n);
+    LOG_ERROR("EventLoop::handleRead() reads {} bytes instead of 8", n);
   }
 }
 
 void EventLoop::wakeup()
 {
+    MUDUO_PROBE1(wakeup, this);
+    if (m_metricsEnabled.load(std::memory_order_relaxed))
+    {
+        m_metrics.countWakeup();
+    }
     uint64_t one = 1;
     ssize_t n = write(m_wakeupFd, &one, sizeof one);
     if (n != sizeof one)
     {
-        LOG_ERROR("EventLoop::wakeup() writes %lu bytes instead of 8 \n", n);
+        LOG_ERROR("EventLoop::wakeup() writes {} bytes instead of 8 \n", n);
     }
 }
 
@@ -169,6 +282,43 @@ void EventLoop::updateChannel(Channel *inChannel)
 void EventLoop::removeChannel(Channel *inChannel)
 {
     m_poller->removeChannel(inChannel);
+    if (inChannel->readyQueued())
+    {
+        m_readyChannels.erase(std::remove(m_readyChannels.begin(), m_readyChannels.end(), inChannel),
+                              m_readyChannels.end());
+        inChannel->setReadyQueued(false);
+    }
+}
+
+void EventLoop::queueReadyChannel(Channel *inChannel)
+{
+    if (!inChannel->readyQueued())
+    {
+        inChannel->setReadyQueued(true);
+        m_readyChannels.push_back(inChannel);
+    }
+}
+
+void EventLoop::addReadyChannels()
+{
+    // Stamp what epoll reported so the ready list is merged in one pass
+    for (Channel *channel : m_activeChannels)
+    {
+        channel->setActiveIteration(m_iteration);
+    }
+    ChannelList ready;
+    ready.swap(m_readyChannels);
+    for (Channel *channel : ready)
+    {
+        channel->setReadyQueued(false);
+        // Channels epoll reported again are already active with fresh revents
+        if (channel->isReading() && channel->activeIteration() != m_iteration)
+        {
+            channel->setRevents(EPOLLIN);
+            channel->setActiveIteration(m_iteration);
+            m_activeChannels.push_back(channel);
+        }
+    }
 }
 
 bool EventLoop::hasChannel(Channel *inChannel)
@@ -176,20 +326,149 @@ bool EventLoop::hasChannel(Channel *inChannel)
     return m_poller->hasChannel(inChannel);
 }
 
-void EventLoop::doPendingFunctors() // Execute callbacks
+void EventLoop::doPendingFunctors(bool inPollIdle, bool inMetrics) // Execute callbacks
 {
+    const int64_t start = inMetrics ? monotonicNanos() : 0;
+    std::vector<Functor> urgent;
     std::vector<Functor> functors;
+    std::vector<Functor> idle;
     m_callingPendingFunctors = true;
+    MUDUO_PROBE1(functors__begin, this);
+    if (m_watched)
+    {
+        m_heartbeat.phase.store(LoopHeartbeat::kRunningFunctors, std::memory_order_relaxed);
+        m_heartbeat.fd.store(-1, std::memory_order_relaxed);
+        m_heartbeat.ownerId.store(0, std::memory_order_relaxed);
+    }
 
     {
         std::unique_lock<std::mutex> lock(m_mutex);
+        urgent.swap(m_urgentFunctors);
         functors.swap(m_pendingFunctors); // swap instead of move, more efficient
+        if (inPollIdle)
+        {
+            idle.swap(m_idleFunctors);
+            m_idlePending = false;
+        }
     }
 
-    for (const Functor &functor : functors)
+    for (const Functor &functor : urgent)
     {
-        functor(); // Execute callback operations that the current loop needs to perform
+        noteCallback(functor.target_type());
+        functor();
+    }
+
+    // Monotonic, so wall clock steps neither cut the budget short nor stretch it
+    const int64_t deadline = m_functorTimeBudgetUs > 0
+        ? monotonicNanos() + m_functorTimeBudgetUs * 1000
+        : 0;
+
+    // Execute callback operations that the current loop needs to perform
+    const size_t ran = runUntilDeadline(functors, deadline);
+    m_functorsCarriedOver = ran < functors.size();
+    const size_t idleRan = m_functorsCarriedOver ? 0 : runUntilDeadline(idle, deadline);
+
+    // Leftovers go back in front of anything queued meanwhile, keeping their order
+    if (m_functorsCarriedOver || idleRan < idle.size())
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pendingFunctors.insert(m_pendingFunctors.begin(),
+                                 std::make_move_iterator(functors.begin() + ran),
+                                 std::make_move_iterator(functors.end()));
+        if (idleRan < idle.size())
+        {
+            m_idleFunctors.insert(m_idleFunctors.begin(),
+                                  std::make_move_iterator(idle.begin() + idleRan),
+                                  std::make_move_iterator(idle.end()));
+            m_idlePending = true;
+        }
+    }
+
+    // Still flagged as calling functors, so callbacks queued by a flush wake up the next poll
+    if (m_watched)
+    {
+        m_heartbeat.phase.store(LoopHeartbeat::kFlushing, std::memory_order_relaxed);
+        m_heartbeat.callback.store(nullptr, std::memory_order_relaxed);
+    }
+    doPendingFlushes();
+    if (m_writeScheduler)
+    {
+        m_writeScheduler->run();
     }
 
     m_callingPendingFunctors = false;
+    MUDUO_PROBE2(functors__end, this, urgent.size() + ran + idleRan);
+    if (inMetrics)
+    {
+        m_metrics.recordFunctors(urgent.size() + functors.size() + idle.size(),
+                                 urgent.size() + ran + idleRan, monotonicNanos() - start);
+    }
+}
+
+size_t EventLoop::runUntilDeadline(std::vector<Functor> &inFunctors, int64_t inDeadlineNs)
+{
+    size_t ran = 0;
+    for (const Functor &functor : inFunctors)
+    {
+        if (inDeadlineNs > 0 && ran > 0 && monotonicNanos() >= inDeadlineNs)
+        {
+            break;
+        }
+        noteCallback(functor.target_type());
+        functor();
+        ++ran;
+    }
+    return ran;
+}
+
+void EventLoop::finishWatchedIteration(int64_t inBusySince, int64_t inThreshold)
+{
+    const int64_t busy = monotonicNanos() - inBusySince;
+    m_heartbeat.busySince.store(0, std::memory_order_relaxed);
+    m_heartbeat.phase.store(LoopHeartbeat::kPolling, std::memory_order_relaxed);
+    m_heartbeat.fd.store(-1, std::memory_order_relaxed);
+    m_heartbeat.ownerId.store(0, std::memory_order_relaxed);
+    m_heartbeat.callback.store(nullptr, std::memory_order_relaxed);
+    if (busy > inThreshold)
+    {
+        m_metrics.recordStall(busy);
+    }
+}
+
+void EventLoop::updatePerfCounters(bool inEnabled)
+{
+    m_perfCounters.reset();
+    m_perfEvents = 0;
+    if (inEnabled)
+    {
+        auto counters = std::make_unique<PerfCounters>();
+        if (counters->valid())
+        {
+            LOG_INFO("EventLoop {} counting {}{}\n", this,
+                     counters->hasHardware() ? "cycles, instructions, cache misses and context switches"
+                                             : "context switches (no hardware counters)",
+                     counters->countsKernel() ? "" : " in user space");
+            m_perfCounters = std::move(counters);
+        }
+        else
+        {
+            // Do not retry every iteration
+            m_perfCountersEnabled.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+void EventLoop::doPendingFlushes()
+{
+    std::vector<Functor> flushes;
+    while (!m_pendingFlushes.empty())
+    {
+        flushes.clear();
+        flushes.swap(m_pendingFlushes);
+        for (const Functor &flush : flushes)
+        {
+            noteCallback(flush.target_type());
+            flush();
+        }
+    }
 }
@@ -3,10 +3,15 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "Channel.h"
+#include "LoopMetrics.h"
+#include "PerfCounters.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "WriteScheduler.h"
 
 #include <functional>
 #include <memory>
+#include <typeinfo>
 #include <vector>
 #include <atomic>
 #include <mutex>
@@ -25,6 +30,21 @@ public:
     using ChannelList = std::vector<Channel *>;
     using Functor = std::function<void()>;
 
+    /**
+     * @brief Lanes for queued functors
+     * 
+     * Urgent functors always run completely each iteration, before normal ones.
+     * Normal functors are subject to the functor time budget; leftovers carry over
+     * to the next iteration. Idle functors only run in iterations where poll
+     * reported no events.
+     */
+    enum class Priority
+    {
+        Urgent,
+        Normal,
+        Idle,
+    };
+
     EventLoop();
 
     ~EventLoop();
@@ -65,7 +85,78 @@ public:
      * Thread-safe method to queue callback and wake up the loop
      * The callback will be executed by the loop thread
      */
-    void queueInLoop(Functor inCallback);
+    void queueInLoop(Functor inCallback, Priority inPriority = Priority::Normal);
+
+    /**
+     * @brief Bounds the time spent on normal and idle functors per iteration
+     * 
+     * Once the budget is spent, the remaining functors run in later iterations
+     * and the next poll does not block. 0 (the default) means unlimited.
+     * Must be called from the loop thread.
+     */
+    void setFunctorTimeBudget(int64_t inMicroseconds) { m_functorTimeBudgetUs = inMicroseconds; }
+
+    /**
+     * @brief Queues a flush callback that runs once after the current batch
+     * 
+     * Flushes run after active channels and pending functors have been processed,
+     * so all output produced during one iteration can be written with one syscall.
+     * Must be called from the loop thread.
+     */
+    void queueFlush(Functor inCallback);
+
+    /**
+     * @brief Enables weighted fair write scheduling for connections of this loop
+     * 
+     * Connection output is then written by the WriteScheduler once per iteration,
+     * after pending functors and flushes. Must be called from the loop thread.
+     * 
+     * @param inBytesPerIteration Upper bound on bytes written per iteration
+     * @param inQuantum Credit per round for a connection of weight 1
+     */
+    void enableWriteScheduler(size_t inBytesPerIteration, size_t inQuantum);
+
+    /**
+     * @brief Gets the write scheduler, nullptr if write scheduling is disabled
+     */
+    WriteScheduler* writeScheduler() const { return m_writeScheduler.get(); }
+
+    /**
+     * @brief Sets the default per-connection read budget for each iteration
+     * 
+     * A connection handles at most inMessagesPerIteration read + MessageCallback
+     * rounds and inBytesPerIteration bytes (0 = unlimited) before the loop moves on
+     * to other channels. Defaults are unlimited bytes and one round, i.e. one read
+     * per readiness event. Must be called from the loop thread.
+     */
+    void setReadBudget(size_t inBytesPerIteration, size_t inMessagesPerIteration)
+    {
+        m_readBytesBudget = inBytesPerIteration;
+        m_readMessagesBudget = inMessagesPerIteration;
+    }
+
+    size_t readBytesBudget() const { return m_readBytesBudget; }
+    size_t readMessagesBudget() const { return m_readMessagesBudget; }
+
+    /**
+     * @brief Dispatches a channel's read callback again next iteration without
+     *        waiting for epoll to report it
+     * 
+     * Used by channels that stopped early because of the read budget. The next poll
+     * does not block while channels are queued. Loop thread only.
+     */
+    void queueReadyChannel(Channel *inChannel);
+
+    /**
+     * @brief Timer operations, thread-safe; callbacks run in the loop thread
+     * 
+     * runAt runs the callback at a point in time, runAfter after a delay in seconds,
+     * runEvery repeatedly with the given interval in seconds.
+     */
+    TimerId runAt(Timestamp inTime, Functor inCallback);
+    TimerId runAfter(double inDelay, Functor inCallback);
+    TimerId runEvery(double inInterval, Functor inCallback);
+    void cancel(TimerId inTimerId);
 
     /**
      * @brief Wakes up the loop thread
@@ -83,6 +174,61 @@ public:
     void removeChannel(Channel *inChannel); // Removes channel from poller
     bool hasChannel(Channel *inChannel); // Checks if channel exists in current loop
 
+    /**
+     * @brief Turns runtime metrics collection on or off; thread-safe
+     * 
+     * While enabled, each iteration records the time blocked in poll, the number
+     * of active channels, the duration of every Channel::handleEvent and of the
+     * pending functors phase, and the functor queue depth. Off by default.
+     */
+    void setMetricsEnabled(bool inEnabled) { m_metricsEnabled.store(inEnabled, std::memory_order_relaxed); }
+    bool metricsEnabled() const { return m_metricsEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Turns performance counter sampling on or off; thread-safe
+     * 
+     * While enabled, the loop thread keeps PerfCounters open for itself and reads
+     * them when poll is entered and when it returns, one read(2) each, splitting
+     * cycles, instructions, cache misses and context switches between the poll
+     * and the dispatch phase (channels, functors, flushes) of every iteration.
+     * Results appear in metricsSnapshot(). Off by default; takes effect at the
+     * next iteration.
+     */
+    void setPerfCountersEnabled(bool inEnabled) { m_perfCountersEnabled.store(inEnabled, std::memory_order_relaxed); }
+    bool perfCountersEnabled() const { return m_perfCountersEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Copies this loop's metrics; thread-safe and lock-free
+     */
+    LoopMetricsSnapshot metricsSnapshot() const { return m_metrics.snapshot(); }
+
+    /**
+     * @brief Sets the iteration length above which an iteration counts as a stall; thread-safe
+     * 
+     * While the threshold is non-zero, the loop publishes what it is running in
+     * heartbeat() and records every iteration that takes longer in the stallNs
+     * histogram of its metrics. 0 (the default) turns both off. Set by LoopWatchdog.
+     */
+    void setStallThreshold(int64_t inNanoseconds) { m_stallThresholdNs.store(inNanoseconds, std::memory_order_relaxed); }
+
+    const LoopHeartbeat& heartbeat() const { return m_heartbeat; }
+
+    /**
+     * @brief Publishes the type of a callback about to run, for stall reports; loop thread only
+     */
+    void noteCallback(const std::type_info &inType)
+    {
+        if (m_watched)
+        {
+            m_heartbeat.callback.store(inType.name(), std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Kernel thread id of the loop thread
+     */
+    pid_t threadId() const { return m_threadId; }
+
     /**
      * @brief Checks if current thread is the loop thread
      * 
@@ -99,9 +245,40 @@ private:
 
     /**
      * @brief Executes pending callbacks
-     * Processes all callbacks in the pending queue
+     * Runs all urgent callbacks, then normal ones within the time budget, then
+     * idle ones if this iteration's poll reported no events
+     * @param inPollIdle Whether poll returned without any active channel
+     * @param inMetrics Whether to record metrics for this iteration
+     */
+    void doPendingFunctors(bool inPollIdle, bool inMetrics);
+
+    /**
+     * @brief Runs functors in order until the deadline passes
+     * @param inDeadlineNs monotonicNanos() deadline, 0 for none
+     * @return Number of functors that ran
+     */
+    size_t runUntilDeadline(std::vector<Functor> &inFunctors, int64_t inDeadlineNs);
+
+    /**
+     * @brief Appends channels re-queued by queueReadyChannel() to the active list
+     */
+    void addReadyChannels();
+
+    /**
+     * @brief Clears the heartbeat before the next poll and records the iteration if it stalled
+     */
+    void finishWatchedIteration(int64_t inBusySince, int64_t inThreshold);
+
+    /**
+     * @brief Opens or closes the performance counters to match m_perfCountersEnabled; loop thread only
+     */
+    void updatePerfCounters(bool inEnabled);
+
+    /**
+     * @brief Executes queued flushes
+     * Runs every flush registered through queueFlush() during this iteration
      */
-    void doPendingFunctors();
+    void doPendingFlushes();
 
     std::atomic_bool m_looping;
     std::atomic_bool m_quit;
@@ -109,6 +286,7 @@ private:
 
     Timestamp m_pollReturnTime; // Records when the poller last returned with active events
     std::unique_ptr<Poller> m_poller; // Manages the lifetime of the Poller object
+    std::unique_ptr<TimerQueue> m_timerQueue; // Timers of this loop, destroyed before the Poller
 
     /**
      * @brief File descriptor for waking up the event loop
@@ -125,7 +303,26 @@ private:
     std::unique_ptr<Channel> m_wakeupChannel;
 
     ChannelList m_activeChannels; // Stores channels that have pending events to process
+    ChannelList m_readyChannels;  // Channels re-queued by queueReadyChannel() for the next iteration
+    uint64_t m_iteration{0};      // Loop iterations so far, stamps channels put on the active list
+    size_t m_readBytesBudget{0};
+    size_t m_readMessagesBudget{1};
     std::atomic_bool m_callingPendingFunctors;
     std::vector<Functor> m_pendingFunctors; // Stores callbacks that need to be executed in the loop thread
+    std::vector<Functor> m_urgentFunctors;  // Urgent lane, guarded by m_mutex
+    std::vector<Functor> m_idleFunctors;    // Idle lane, guarded by m_mutex
+    std::atomic_bool m_idlePending{false};  // m_idleFunctors is not empty
+    bool m_functorsCarriedOver{false};      // normal functors left over by the time budget
+    int64_t m_functorTimeBudgetUs{0};
+    std::vector<Functor> m_pendingFlushes; // Output flushes for this iteration, loop thread only
+    std::unique_ptr<WriteScheduler> m_writeScheduler; // Optional fair scheduling of connection output
+    std::atomic_bool m_metricsEnabled{false};
+    LoopMetrics m_metrics; // written by the loop thread, read by metricsSnapshot()
+    std::atomic<int64_t> m_stallThresholdNs{0};
+    bool m_watched{false};    // m_stallThresholdNs was set when this iteration started, loop thread only
+    LoopHeartbeat m_heartbeat;
+    std::atomic_bool m_perfCountersEnabled{false};
+    std::unique_ptr<PerfCounters> m_perfCounters; // loop thread only
+    size_t m_perfEvents{0};                       // channels dispatched since the last poll
     std::mutex m_mutex;
 };
@@ -32,10 +32,46 @@ void EventLoopThreadPool::start(const EventLoopThread::ThreadInitCallback &inCal
             EventLoopThread *thread = new EventLoopThread(inCallback, buf);
             m_threads.push_back(std::unique_ptr<EventLoopThread>(thread));
             m_loops.push_back(thread->startLoop()); // starts the thread, creates and binds an EventLoop in the new thread context
+            m_loops.back()->setMetricsEnabled(m_metricsEnabled);
+            m_loops.back()->setPerfCountersEnabled(m_perfCountersEnabled);
         }
     }
 }
 
+void EventLoopThreadPool::setMetricsEnabled(bool inEnabled)
+{
+    m_metricsEnabled = inEnabled;
+    m_baseLoop->setMetricsEnabled(inEnabled);
+    for (EventLoop *loop : m_loops)
+    {
+        loop->setMetricsEnabled(inEnabled);
+    }
+}
+
+void EventLoopThreadPool::setPerfCountersEnabled(bool inEnabled)
+{
+    m_perfCountersEnabled = inEnabled;
+    m_baseLoop->setPerfCountersEnabled(inEnabled);
+    for (EventLoop *loop : m_loops)
+    {
+        loop->setPerfCountersEnabled(inEnabled);
+    }
+}
+
+LoopMetricsSnapshot EventLoopThreadPool::metricsSnapshot() const
+{
+    if (m_loops.empty())
+    {
+        return m_baseLoop->metricsSnapshot();
+    }
+    LoopMetricsSnapshot total;
+    for (EventLoop *loop : m_loops)
+    {
+        total.merge(loop->metricsSnapshot());
+    }
+    return total;
+}
+
 
 EventLoop* EventLoopThreadPool::getNextLoop()
 {
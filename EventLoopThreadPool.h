@@ -66,6 +66,23 @@ public:
      */
     std::vector<EventLoop*> getAllLoops();
 
+    /**
+     * @brief Turns metrics collection on or off for every loop of the pool,
+     *        including loops started later
+     */
+    void setMetricsEnabled(bool inEnabled);
+
+    /**
+     * @brief Turns performance counter sampling on or off for every loop of the
+     *        pool, including loops started later; see EventLoop::setPerfCountersEnabled
+     */
+    void setPerfCountersEnabled(bool inEnabled);
+
+    /**
+     * @brief Sum of the metrics of all loops returned by getAllLoops(); thread-safe
+     */
+    LoopMetricsSnapshot metricsSnapshot() const;
+
     /**
      * @brief Checks if the thread pool has been started
      * @return true if the pool has been started, false otherwise
@@ -84,6 +101,8 @@ private:
     bool m_started;             // Flag indicating if the pool has been started
     int m_numThreads;           // Number of sub-threads in the pool
     size_t m_next;              // Index for round-robin selection of EventLoops
+    bool m_metricsEnabled{false};
+    bool m_perfCountersEnabled{false};
     
     // Using unique_ptr for automatic resource management of threads
     std::vector<std::unique_ptr<EventLoopThread>> m_threads;
@@ -0,0 +1,68 @@
+#include "LogFile.h"
+
+#include <ctime>
+#include <unistd.h>
+
+std::string LogFile::makeFileName(const std::string &inBasename, int inSequence)
+{
+    char suffix[64] = {0};
+    time_t now = ::time(nullptr);
+    tm tm_time;
+    localtime_r(&now, &tm_time);
+    strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm_time);
+    std::string name = inBasename + suffix + "." + std::to_string(::getpid());
+    if (inSequence != 0)
+    {
+        name += "." + std::to_string(inSequence);
+    }
+    return name + ".log";
+}
+
+LogFile::LogFile(const std::string &inBasename)
+    : m_fileName(makeFileName(inBasename))
+    , m_fp(::fopen(m_fileName.c_str(), "ae"))  // 'e' for O_CLOEXEC
+{
+    if (m_fp == nullptr)
+    {
+        // No Logger here: the logger may be the one writing to this file
+        fprintf(stderr, "LogFile: cannot open %s\n", m_fileName.c_str());
+        return;
+    }
+    ::setvbuf(m_fp, m_buffer, _IOFBF, sizeof(m_buffer));
+}
+
+LogFile::~LogFile()
+{
+    if (m_fp != nullptr)
+    {
+        ::fclose(m_fp);
+    }
+}
+
+void LogFile::append(const char *inData, size_t inLen)
+{
+    if (m_fp == nullptr)
+    {
+        return;
+    }
+    size_t written = 0;
+    while (written < inLen)
+    {
+        const size_t n = ::fwrite_unlocked(inData + written, 1, inLen - written, m_fp);
+        if (n == 0)
+        {
+            fprintf(stderr, "LogFile::append failed on %s\n", m_fileName.c_str());
+            break;
+        }
+        written += n;
+    }
+    m_writtenBytes += written;
+}
+
+void LogFile::flush()
+{
+    if (m_fp != nullptr)
+    {
+        ::fflush(m_fp);
+    }
+}
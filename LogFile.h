@@ -0,0 +1,38 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstdio>
+#include <string>
+
+/**
+ * @brief Append-only log file written by a single thread
+ *
+ * The file is named <basename>.<YYYYmmdd-HHMMSS>.<pid>.log and written through a
+ * large stdio buffer without locking, so it must only be used by one thread
+ * (normally the AsyncLogging backend).
+ */
+class LogFile : noncopyable
+{
+public:
+    explicit LogFile(const std::string &inBasename);
+    ~LogFile();
+
+    void append(const char *inData, size_t inLen);
+    void flush();
+
+    [[nodiscard]] const std::string& fileName() const noexcept { return m_fileName; }
+    [[nodiscard]] size_t writtenBytes() const noexcept { return m_writtenBytes; }
+
+    /**
+     * @brief <inBasename>.<YYYYmmdd-HHMMSS>.<pid>[.<inSequence>].log for the current time
+     * @param inSequence Appended when non-zero, to tell apart files opened in the same second
+     */
+    static std::string makeFileName(const std::string &inBasename, int inSequence = 0);
+
+private:
+    std::string m_fileName;
+    FILE *m_fp;
+    size_t m_writtenBytes{0};
+    char m_buffer[64 * 1024];
+};
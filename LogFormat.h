@@ -0,0 +1,178 @@
+#pragma once
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief "{}" formatting used by the LOG_* macros
+ *
+ * Every "{}" is replaced by the next argument, formatted according to its type;
+ * "{{" and "}}" produce literal braces. Anything between the braces is ignored.
+ * The LOG_* macros check at compile time that the number of placeholders equals
+ * the number of arguments.
+ */
+namespace logdetail
+{
+
+/**
+ * @brief Number of "{}" placeholders in inFormat, usable in static_assert
+ */
+constexpr size_t placeholderCount(std::string_view inFormat)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < inFormat.size(); ++i)
+    {
+        if (inFormat[i] == '{')
+        {
+            if (i + 1 < inFormat.size() && inFormat[i + 1] == '{')
+            {
+                ++i;
+                continue;
+            }
+            while (i < inFormat.size() && inFormat[i] != '}')
+            {
+                ++i;
+            }
+            ++count;
+        }
+        else if (inFormat[i] == '}' && i + 1 < inFormat.size() && inFormat[i + 1] == '}')
+        {
+            ++i;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Declared only: sizeof(countArgs(args...)) - 1 is the number of arguments,
+ *        without evaluating or copying them
+ */
+template <typename... Args>
+char (&countArgs(const Args&...))[sizeof...(Args) + 1];
+
+/**
+ * @brief Fixed-capacity line; output beyond the capacity is truncated
+ */
+class LogLine
+{
+public:
+    static constexpr size_t kCapacity = 1024;
+
+    void append(const char *inData, size_t inLen) noexcept
+    {
+        const size_t n = inLen < kCapacity - m_len ? inLen : kCapacity - m_len;
+        std::memcpy(m_data + m_len, inData, n);
+        m_len += n;
+    }
+
+    void append(std::string_view inText) noexcept { append(inText.data(), inText.size()); }
+
+    [[nodiscard]] std::string_view view() const noexcept { return {m_data, m_len}; }
+
+private:
+    char m_data[kCapacity];
+    size_t m_len{0};
+};
+
+template <typename T>
+inline constexpr bool kUnsupportedArgument = false;
+
+template <typename T>
+void appendArg(LogLine &outLine, const T &inArg)
+{
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, bool>)
+    {
+        outLine.append(inArg ? std::string_view("true") : std::string_view("false"));
+    }
+    else if constexpr (std::is_same_v<D, char>)
+    {
+        outLine.append(&inArg, 1);
+    }
+    else if constexpr (std::is_integral_v<D>)
+    {
+        char buf[24];
+        const auto result = std::to_chars(buf, buf + sizeof(buf), inArg);
+        outLine.append(buf, static_cast<size_t>(result.ptr - buf));
+    }
+    else if constexpr (std::is_floating_point_v<D>)
+    {
+        char buf[32];
+        const int n = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(inArg));
+        outLine.append(buf, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+    else if constexpr (std::is_enum_v<D>)
+    {
+        appendArg(outLine, static_cast<std::underlying_type_t<D>>(inArg));
+    }
+    else if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+    {
+        const char *text = inArg;
+        outLine.append(text != nullptr ? std::string_view(text) : std::string_view("(null)"));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        outLine.append(std::string_view(inArg));
+    }
+    else if constexpr (std::is_pointer_v<D> || std::is_null_pointer_v<D>)
+    {
+        char buf[24];
+        const int n = std::snprintf(buf, sizeof(buf), "%p", static_cast<const void*>(inArg));
+        outLine.append(buf, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+    else
+    {
+        static_assert(kUnsupportedArgument<T>, "unsupported LOG_* argument type");
+    }
+}
+
+/**
+ * @brief Appends the literal text up to the next placeholder, which is consumed
+ * @return false when inFormat has no placeholder left
+ */
+inline bool appendLiteral(LogLine &outLine, std::string_view inFormat, size_t &ioPos)
+{
+    while (ioPos < inFormat.size())
+    {
+        const size_t brace = inFormat.find_first_of("{}", ioPos);
+        if (brace == std::string_view::npos)
+        {
+            outLine.append(inFormat.substr(ioPos));
+            ioPos = inFormat.size();
+            break;
+        }
+        outLine.append(inFormat.substr(ioPos, brace - ioPos));
+
+        const char c = inFormat[brace];
+        if (brace + 1 < inFormat.size() && inFormat[brace + 1] == c)
+        {
+            outLine.append(&c, 1);  // escaped "{{" or "}}"
+            ioPos = brace + 2;
+        }
+        else if (c == '{')
+        {
+            const size_t close = inFormat.find('}', brace);
+            ioPos = close == std::string_view::npos ? inFormat.size() : close + 1;
+            return true;
+        }
+        else
+        {
+            outLine.append(&c, 1);  // stray '}'
+            ioPos = brace + 1;
+        }
+    }
+    return false;
+}
+
+template <typename... Args>
+void format(LogLine &outLine, std::string_view inFormat, const Args&... inArgs)
+{
+    size_t pos = 0;
+    ((appendLiteral(outLine, inFormat, pos) ? appendArg(outLine, inArgs) : void()), ...);
+    appendLiteral(outLine, inFormat, pos);
+}
+
+}  // namespace logdetail
@@ -1,38 +1,173 @@
 #include "Logger.h"
 #include "Timestamp.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 
-Logger& Logger::instance()
+/**
+ * @brief Lines logged by one thread, registered with the Logger while the thread lives
+ *
+ * Only the owning thread writes, so counting is a plain load and store; atomics
+ * only make concurrent reads by linesLogged() well defined.
+ */
+struct Logger::ThreadLineCounts
 {
-    static Logger logger;
-    return logger;
+    ThreadLineCounts()
+    {
+        Logger &logger = Logger::instance();
+        std::lock_guard<std::mutex> lock(logger.m_countsMutex);
+        logger.m_threadCounts.push_back(this);
+    }
+
+    ~ThreadLineCounts()
+    {
+        // Keep the totals of exited threads
+        Logger &logger = Logger::instance();
+        std::lock_guard<std::mutex> lock(logger.m_countsMutex);
+        for (int level = DEBUG; level <= FATAL; ++level)
+        {
+            logger.m_exitedLines[level] += lines[level].load(std::memory_order_relaxed);
+        }
+        auto &counts = logger.m_threadCounts;
+        counts.erase(std::remove(counts.begin(), counts.end(), this), counts.end());
+    }
+
+    void count(int inLevel) noexcept
+    {
+        lines[inLevel].store(lines[inLevel].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> lines[FATAL + 1]{};
+};
+
+Logger::ThreadLineCounts& Logger::threadLineCounts()
+{
+    thread_local ThreadLineCounts counts;
+    return counts;
+}
+
+namespace
+{
+void defaultOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stdout);
+}
+
+void defaultFlush()
+{
+    ::fflush(stdout);
 }
 
-void Logger::setLogLevel(int level)
+// Formatting the date is the expensive part of a line; redo it once per second
+thread_local time_t t_lastSecond = 0;
+thread_local char t_time[64];
+
+const char* formattedNow()
 {
-    logLevel_ = level;
+    const time_t seconds = static_cast<time_t>(
+        Timestamp::now().microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    if (seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        snprintf(t_time, sizeof(t_time), "%4d/%02d/%02d %02d:%02d:%02d",
+                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    }
+    return t_time;
 }
+}  // namespace
 
-void Logger::log(std::string msg)
+const char* Logger::levelName(int inLevel) noexcept
 {
-    switch (logLevel_)
+    switch (inLevel)
     {
     case INFO:
-        std::cout << "[INFO]";
-        break;
+        return "[INFO]";
     case ERROR:
-        std::cout << "[ERROR]";
-        break;
+        return "[ERROR]";
     case FATAL:
-        std::cout << "[FATAL]";
-        break;
+        return "[FATAL]";
     case DEBUG:
-        std::cout << "[DEBUG]";
-        break;
+        return "[DEBUG]";
     default:
-        break;
+        return "";
+    }
+}
+
+Logger& Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+void Logger::setOutput(OutputFunc inOutput)
+{
+    output_ = std::move(inOutput);
+}
+
+void Logger::setFlush(FlushFunc inFlush)
+{
+    flush_ = std::move(inFlush);
+}
+
+void Logger::flush()
+{
+    if (flush_)
+    {
+        flush_();
+    }
+    else
+    {
+        defaultFlush();
+    }
+}
+
+uint64_t Logger::linesLogged(int inLevel) const
+{
+    if (inLevel < DEBUG || inLevel > FATAL)
+    {
+        return 0;
     }
+    std::lock_guard<std::mutex> lock(m_countsMutex);
+    uint64_t total = m_exitedLines[inLevel];
+    for (const ThreadLineCounts *counts : m_threadCounts)
+    {
+        total += counts->lines[inLevel].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Logger::log(int inLevel, std::string_view inMsg)
+{
+    // Messages may still end with '\n'; every line gets exactly one
+    if (!inMsg.empty() && inMsg.back() == '\n')
+    {
+        inMsg.remove_suffix(1);
+    }
+
+    logdetail::LogLine line;
+    line.append(levelName(inLevel));
+    line.append(formattedNow());
+    line.append(" : ");
+    line.append(inMsg.substr(0, logdetail::LogLine::kCapacity - 64));
+    line.append("\n", 1);
 
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    if (inLevel >= DEBUG && inLevel <= FATAL)
+    {
+        threadLineCounts().count(inLevel);
+    }
+
+    const std::string_view text = line.view();
+    if (output_)
+    {
+        output_(text.data(), text.size());
+    }
+    else
+    {
+        defaultOutput(text.data(), text.size());
+    }
+}
@@ -1,69 +1,150 @@
 #pragma once
 
-#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
 
 #include "noncopyable.h"
+#include "LogFormat.h"
+#include "BinaryLog.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+enum LogLevel
+{
+    DEBUG,
+    INFO,
+    ERROR,
+    FATAL,
+};
+
+// Levels below this are compiled out; defaults to INFO, or DEBUG with MUDEBUG
+#ifndef MUDUO_LOG_MIN_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_LOG_MIN_LEVEL 0
+#else
+#define MUDUO_LOG_MIN_LEVEL 1
+#endif
+#endif
 
-#define LOG_ERROR(logmsgFormat, ...) \
+// LOG_INFO("{} {}", arg1, arg2): arguments are formatted by type, and the number
+// of "{}" placeholders is checked against the number of arguments at compile time.
+// Nothing is formatted for records below the runtime threshold (Logger::setLogLevel).
+// While BinaryLog is active, records are stored unformatted instead.
+#define MUDUO_LOG(level, logmsgFormat, ...) \
     do \
     { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
+        static_assert(logdetail::placeholderCount(logmsgFormat) \
+                          == sizeof(logdetail::countArgs(__VA_ARGS__)) - 1, \
+                      "log format placeholders do not match the number of arguments"); \
+        if constexpr ((level) >= MUDUO_LOG_MIN_LEVEL) \
+        { \
+            if ((level) >= Logger::logLevel()) \
+            { \
+                if (BinaryLog::active()) \
+                { \
+                    static constexpr logdetail::LogSite logSite{(level), __FILE__, __LINE__, logmsgFormat}; \
+                    static std::atomic<uint32_t> logSiteId{0}; \
+                    BinaryLog::instance().record(logSiteId, logSite, ##__VA_ARGS__); \
+                } \
+                else \
+                { \
+                    logdetail::LogLine logLine; \
+                    logdetail::format(logLine, logmsgFormat, ##__VA_ARGS__); \
+                    Logger::instance().log((level), logLine.view()); \
+                } \
+            } \
+        } \
+    } while(0)
 
+#define LOG_DEBUG(logmsgFormat, ...) MUDUO_LOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO(logmsgFormat, ...) MUDUO_LOG(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(logmsgFormat, ...) MUDUO_LOG(ERROR, logmsgFormat, ##__VA_ARGS__)
+
+// Always logged as text, then the process exits; an active BinaryLog is
+// persisted and closed first so the records leading up to the fatal survive
 #define LOG_FATAL(logmsgFormat, ...) \
     do \
     { \
+        static_assert(logdetail::placeholderCount(logmsgFormat) \
+                          == sizeof(logdetail::countArgs(__VA_ARGS__)) - 1, \
+                      "log format placeholders do not match the number of arguments"); \
+        if (BinaryLog::active()) \
+        { \
+            BinaryLog::instance().stop(); \
+        } \
+        logdetail::LogLine logLine; \
+        logdetail::format(logLine, logmsgFormat, ##__VA_ARGS__); \
         Logger &logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        logger.log(FATAL, logLine.view()); \
+        logger.flush(); \
         exit(-1); \
-    } while(0) 
-
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do \
-    { \
-        Logger &logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0) 
-#else
-    #define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
-enum LogLevel
-{
-    INFO,
-    ERROR,
-    FATAL, 
-    DEBUG,
-};
+    } while(0)
 
+/**
+ * @brief Formats log lines and hands them to an output function
+ *
+ * The default output writes to stdout through stdio buffering. Install an
+ * AsyncLogging backend with setOutput()/setFlush() to keep file I/O off the
+ * logging threads.
+ */
 class Logger : noncopyable
 {
 public:
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     static Logger& instance();
-    void setLogLevel(int level);
-    void log(std::string msg);
+
+    /**
+     * @brief Runtime threshold: records below inLevel are skipped before formatting
+     * @note Thread-safe
+     */
+    static void setLogLevel(int inLevel) noexcept { s_logLevel.store(inLevel, std::memory_order_relaxed); }
+    [[nodiscard]] static int logLevel() noexcept { return s_logLevel.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Prefix inMsg with its level and the time and write it out as one line
+     */
+    void log(int inLevel, std::string_view inMsg);
+
+    /**
+     * @brief Line prefix for inLevel, e.g. "[INFO]"
+     */
+    [[nodiscard]] static const char* levelName(int inLevel) noexcept;
+
+    /**
+     * @brief Replace where formatted lines go
+     * @note Not thread-safe; call before other threads start logging
+     */
+    void setOutput(OutputFunc inOutput);
+    void setFlush(FlushFunc inFlush);
+
+    /**
+     * @brief Push buffered lines to their destination (called before LOG_FATAL exits)
+     */
+    void flush();
+
+    /**
+     * @brief Lines written through log() at inLevel; thread-safe
+     * @details Each thread counts its own lines; this sums them, so it is meant
+     *          for scrapes rather than hot paths
+     * @note Records stored by BinaryLog are not included
+     */
+    [[nodiscard]] uint64_t linesLogged(int inLevel) const;
 private:
-    int logLevel_;
-};
\ No newline at end of file
+    struct ThreadLineCounts;
+
+    /**
+     * @brief The calling thread's counters, registered on first use
+     */
+    static ThreadLineCounts& threadLineCounts();
+
+    inline static std::atomic<int> s_logLevel{INFO};
+    mutable std::mutex m_countsMutex;
+    std::vector<const ThreadLineCounts*> m_threadCounts;  // Threads that logged, guarded by m_countsMutex
+    uint64_t m_exitedLines[FATAL + 1]{};                  // Lines of threads that exited, guarded by m_countsMutex
+    OutputFunc output_;
+    FlushFunc flush_;
+};
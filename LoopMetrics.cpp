@@ -0,0 +1,106 @@
+#include "LoopMetrics.h"
+
+uint64_t HistogramSnapshot::bucketUpperBound(size_t inIndex) noexcept
+{
+    if (inIndex < kSubBuckets)
+    {
+        return inIndex;
+    }
+    const size_t shift = (inIndex - kSubBuckets) / kSubBuckets;
+    const uint64_t sub = (inIndex - kSubBuckets) % kSubBuckets;
+    const uint64_t lower = (kSubBuckets + sub) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot &inOther) noexcept
+{
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        counts[i] += inOther.counts[i];
+    }
+    count += inOther.count;
+    sum += inOther.sum;
+    if (inOther.max > max)
+    {
+        max = inOther.max;
+    }
+}
+
+uint64_t HistogramSnapshot::percentile(double inQuantile) const noexcept
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(inQuantile * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            const uint64_t bound = bucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+HistogramSnapshot LogLinearHistogram::snapshot() const noexcept
+{
+    HistogramSnapshot snapshot;
+    for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i)
+    {
+        snapshot.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum = m_sum.load(std::memory_order_relaxed);
+    snapshot.max = m_max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void LoopMetricsSnapshot::merge(const LoopMetricsSnapshot &inOther) noexcept
+{
+    iterations += inOther.iterations;
+    eventsHandled += inOther.eventsHandled;
+    functorsRun += inOther.functorsRun;
+    wakeups += inOther.wakeups;
+    pollWaitNs.merge(inOther.pollWaitNs);
+    eventsPerPoll.merge(inOther.eventsPerPoll);
+    dispatchNs.merge(inOther.dispatchNs);
+    functorsNs.merge(inOther.functorsNs);
+    queueDepth.merge(inOther.queueDepth);
+    stallNs.merge(inOther.stallNs);
+    perfIterations += inOther.perfIterations;
+    perfEvents += inOther.perfEvents;
+    pollCounters += inOther.pollCounters;
+    dispatchCounters += inOther.dispatchCounters;
+}
+
+LoopMetricsSnapshot LoopMetrics::snapshot() const noexcept
+{
+    LoopMetricsSnapshot snapshot;
+    snapshot.iterations = m_iterations.load(std::memory_order_relaxed);
+    snapshot.eventsHandled = m_eventsHandled.load(std::memory_order_relaxed);
+    snapshot.functorsRun = m_functorsRun.load(std::memory_order_relaxed);
+    snapshot.wakeups = m_wakeups.load(std::memory_order_relaxed);
+    snapshot.pollWaitNs = m_pollWaitNs.snapshot();
+    snapshot.eventsPerPoll = m_eventsPerPoll.snapshot();
+    snapshot.dispatchNs = m_dispatchNs.snapshot();
+    snapshot.functorsNs = m_functorsNs.snapshot();
+    snapshot.queueDepth = m_queueDepth.snapshot();
+    snapshot.stallNs = m_stallNs.snapshot();
+    snapshot.perfIterations = m_perfIterations.load(std::memory_order_relaxed);
+    snapshot.perfEvents = m_perfEvents.load(std::memory_order_relaxed);
+    snapshot.pollCounters = m_pollCounters.load();
+    snapshot.dispatchCounters = m_dispatchCounters.load();
+    return snapshot;
+}
+
+PerfCounts LoopMetrics::AtomicPerfCounts::load() const noexcept
+{
+    return PerfCounts{cycles.load(std::memory_order_relaxed),
+                      instructions.load(std::memory_order_relaxed),
+                      cacheMisses.load(std::memory_order_relaxed),
+                      contextSwitches.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+/**
+ * @brief Monotonic clock in nanoseconds; a vDSO call, cheap enough to read around every callback
+ */
+inline int64_t monotonicNanos() noexcept
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Point-in-time copy of a LogLinearHistogram, mergeable across loops
+ */
+struct HistogramSnapshot
+{
+    static constexpr size_t kSubBuckets = 8;  // linear steps per power of two, ~12% resolution
+    static constexpr size_t kBuckets = kSubBuckets + (64 - 3) * kSubBuckets;
+
+    /**
+     * @brief Values below kSubBuckets get a bucket each; above, every power of
+     *        two is split into kSubBuckets equal steps
+     */
+    static size_t bucketFor(uint64_t inValue) noexcept
+    {
+        if (inValue < kSubBuckets)
+        {
+            return static_cast<size_t>(inValue);
+        }
+        const int exponent = 63 - __builtin_clzll(inValue);  // >= 3
+        const size_t sub = static_cast<size_t>(inValue >> (exponent - 3)) & (kSubBuckets - 1);
+        return kSubBuckets + static_cast<size_t>(exponent - 3) * kSubBuckets + sub;
+    }
+
+    /**
+     * @brief Largest value that falls into bucket inIndex
+     */
+    static uint64_t bucketUpperBound(size_t inIndex) noexcept;
+
+    void merge(const HistogramSnapshot &inOther) noexcept;
+
+    [[nodiscard]] double mean() const noexcept { return count > 0 ? static_cast<double>(sum) / count : 0.0; }
+
+    /**
+     * @brief Upper bound of the bucket holding the inQuantile-th value (0..1), capped by max
+     */
+    [[nodiscard]] uint64_t percentile(double inQuantile) const noexcept;
+
+    std::array<uint64_t, kBuckets> counts{};
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t max{0};
+};
+
+/**
+ * @brief Log-linear histogram written by one thread and read by any
+ *
+ * record() uses plain relaxed loads and stores, no read-modify-write, so it
+ * costs a few ordinary memory operations; it must only be called by the owning
+ * thread. snapshot() may be called from any thread and sees a slightly stale
+ * but never torn view.
+ */
+class LogLinearHistogram : noncopyable
+{
+public:
+    void record(uint64_t inValue) noexcept
+    {
+        bump(m_counts[HistogramSnapshot::bucketFor(inValue)], 1);
+        bump(m_sum, inValue);
+        if (inValue > m_max.load(std::memory_order_relaxed))
+        {
+            m_max.store(inValue, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] HistogramSnapshot snapshot() const noexcept;
+
+private:
+    static void bump(std::atomic<uint64_t> &ioCounter, uint64_t inDelta) noexcept
+    {
+        ioCounter.store(ioCounter.load(std::memory_order_relaxed) + inDelta, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::kBuckets> m_counts{};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+/**
+ * @brief Performance counter totals of one loop phase, see PerfCounters
+ */
+struct PerfCounts
+{
+    uint64_t cycles{0};
+    uint64_t instructions{0};
+    uint64_t cacheMisses{0};
+    uint64_t contextSwitches{0};
+
+    PerfCounts& operator+=(const PerfCounts &inOther) noexcept
+    {
+        cycles += inOther.cycles;
+        instructions += inOther.instructions;
+        cacheMisses += inOther.cacheMisses;
+        contextSwitches += inOther.contextSwitches;
+        return *this;
+    }
+
+    /**
+     * @brief Difference of two readings; saturates at 0, as scaled readings may step back slightly
+     */
+    PerfCounts operator-(const PerfCounts &inEarlier) const noexcept
+    {
+        return PerfCounts{since(cycles, inEarlier.cycles),
+                          since(instructions, inEarlier.instructions),
+                          since(cacheMisses, inEarlier.cacheMisses),
+                          since(contextSwitches, inEarlier.contextSwitches)};
+    }
+
+    /**
+     * @brief Instructions per cycle, 0 without hardware counters
+     */
+    [[nodiscard]] double ipc() const noexcept
+    { return cycles > 0 ? static_cast<double>(instructions) / static_cast<double>(cycles) : 0.0; }
+
+private:
+    static uint64_t since(uint64_t inNow, uint64_t inEarlier) noexcept { return inNow > inEarlier ? inNow - inEarlier : 0; }
+};
+
+/**
+ * @brief Copy of one loop's metrics, or the sum over several loops
+ */
+struct LoopMetricsSnapshot
+{
+    uint64_t iterations{0};
+    uint64_t eventsHandled{0};
+    uint64_t functorsRun{0};
+    uint64_t wakeups{0};             // wakeup() calls, from any thread
+    HistogramSnapshot pollWaitNs;    // time blocked in Poller::poll
+    HistogramSnapshot eventsPerPoll; // active channels per iteration
+    HistogramSnapshot dispatchNs;    // one Channel::handleEvent
+    HistogramSnapshot functorsNs;    // pending functors, flushes and write scheduling of one iteration
+    HistogramSnapshot queueDepth;    // functors waiting when an iteration picks them up
+    HistogramSnapshot stallNs;       // watched iterations that outlasted the stall threshold
+    uint64_t perfIterations{0};      // iterations measured with performance counters
+    uint64_t perfEvents{0};          // channels dispatched in those iterations
+    PerfCounts pollCounters;         // inside Poller::poll
+    PerfCounts dispatchCounters;     // poll return to next poll: channels, functors, flushes
+
+    void merge(const LoopMetricsSnapshot &inOther) noexcept;
+
+    /**
+     * @brief Dispatch phase counters per dispatched channel, 0 if none was measured
+     */
+    [[nodiscard]] double perEvent(uint64_t PerfCounts::*inCounter) const noexcept
+    { return perfEvents > 0 ? static_cast<double>(dispatchCounters.*inCounter) / static_cast<double>(perfEvents) : 0.0; }
+
+    [[nodiscard]] double cacheMissesPerEvent() const noexcept { return perEvent(&PerfCounts::cacheMisses); }
+    [[nodiscard]] double cyclesPerEvent() const noexcept { return perEvent(&PerfCounts::cycles); }
+};
+
+/**
+ * @brief Runtime metrics of one EventLoop, collected by the loop thread
+ */
+class LoopMetrics : noncopyable
+{
+public:
+    void recordPoll(int64_t inWaitNs, size_t inEvents) noexcept
+    {
+        bump(m_iterations, 1);
+        bump(m_eventsHandled, inEvents);
+        m_pollWaitNs.record(static_cast<uint64_t>(inWaitNs));
+        m_eventsPerPoll.record(inEvents);
+    }
+
+    void recordDispatch(int64_t inNs) noexcept { m_dispatchNs.record(static_cast<uint64_t>(inNs)); }
+
+    void recordFunctors(size_t inQueued, size_t inRan, int64_t inNs) noexcept
+    {
+        bump(m_functorsRun, inRan);
+        m_queueDepth.record(inQueued);
+        m_functorsNs.record(static_cast<uint64_t>(inNs));
+    }
+
+    void recordStall(int64_t inNs) noexcept { m_stallNs.record(static_cast<uint64_t>(inNs)); }
+
+    void recordPerfPoll(const PerfCounts &inCounts) noexcept { bump(m_pollCounters, inCounts); }
+
+    void recordPerfDispatch(const PerfCounts &inCounts, size_t inEvents) noexcept
+    {
+        bump(m_perfIterations, 1);
+        bump(m_perfEvents, inEvents);
+        bump(m_dispatchCounters, inCounts);
+    }
+
+    /**
+     * @brief Thread-safe, unlike the other record functions
+     */
+    void countWakeup() noexcept { m_wakeups.fetch_add(1, std::memory_order_relaxed); }
+
+    [[nodiscard]] LoopMetricsSnapshot snapshot() const noexcept;
+
+private:
+    static void bump(std::atomic<uint64_t> &ioCounter, uint64_t inDelta) noexcept
+    {
+        ioCounter.store(ioCounter.load(std::memory_order_relaxed) + inDelta, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief PerfCounts whose fields are written by the loop thread only
+     */
+    struct AtomicPerfCounts
+    {
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> instructions{0};
+        std::atomic<uint64_t> cacheMisses{0};
+        std::atomic<uint64_t> contextSwitches{0};
+
+        [[nodiscard]] PerfCounts load() const noexcept;
+    };
+
+    static void bump(AtomicPerfCounts &ioCounts, const PerfCounts &inDelta) noexcept
+    {
+        bump(ioCounts.cycles, inDelta.cycles);
+        bump(ioCounts.instructions, inDelta.instructions);
+        bump(ioCounts.cacheMisses, inDelta.cacheMisses);
+        bump(ioCounts.contextSwitches, inDelta.contextSwitches);
+    }
+
+    std::atomic<uint64_t> m_iterations{0};
+    std::atomic<uint64_t> m_eventsHandled{0};
+    std::atomic<uint64_t> m_functorsRun{0};
+    std::atomic<uint64_t> m_wakeups{0};
+    LogLinearHistogram m_pollWaitNs;
+    LogLinearHistogram m_eventsPerPoll;
+    LogLinearHistogram m_dispatchNs;
+    LogLinearHistogram m_functorsNs;
+    LogLinearHistogram m_queueDepth;
+    LogLinearHistogram m_stallNs;
+    std::atomic<uint64_t> m_perfIterations{0};
+    std::atomic<uint64_t> m_perfEvents{0};
+    AtomicPerfCounts m_pollCounters;
+    AtomicPerfCounts m_dispatchCounters;
+};
+
+/**
+ * @brief What a loop is busy with, published for LoopWatchdog
+ *
+ * Written by the loop thread with relaxed stores, only while a watchdog has set
+ * a stall threshold on the loop; read by the watchdog thread. Fields may be a
+ * callback apart from each other, which is fine for a diagnostic.
+ */
+struct LoopHeartbeat
+{
+    enum Phase : uint8_t
+    {
+        kPolling,
+        kDispatching,
+        kRunningFunctors,
+        kFlushing,
+    };
+
+    std::atomic<int64_t> busySince{0};          // monotonicNanos() when the iteration left poll, 0 while polling
+    std::atomic<uint8_t> phase{kPolling};
+    std::atomic<int> fd{-1};                    // channel being dispatched
+    std::atomic<uint64_t> ownerId{0};           // Channel::ownerId() of that channel
+    std::atomic<const char*> callback{nullptr}; // type_info::name() of the functor or timer callback running
+};
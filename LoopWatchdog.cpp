@@ -0,0 +1,269 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr int kMaxFrames = 64;
+constexpr int kHandlerFrames = 2;  // the handler and the signal trampoline
+constexpr auto kCaptureTimeout = std::chrono::milliseconds(100);
+
+// One capture at a time per process; the handler only touches these
+std::mutex g_captureMutex;
+std::atomic<pid_t> g_captureTarget{0};
+std::atomic<int> g_frameCount{-1};
+void *g_frames[kMaxFrames];
+
+void captureHandler(int)
+{
+    const int savedErrno = errno;
+    if (g_captureTarget.load(std::memory_order_acquire) == static_cast<pid_t>(::syscall(SYS_gettid)))
+    {
+        g_frameCount.store(::backtrace(g_frames, kMaxFrames), std::memory_order_release);
+    }
+    errno = savedErrno;
+}
+
+void installCaptureHandler(int inSignal)
+{
+    // The first backtrace() loads libgcc, which allocates; do it outside the handler
+    void *frame;
+    ::backtrace(&frame, 1);
+
+    struct sigaction action = {};
+    action.sa_handler = captureHandler;
+    action.sa_flags = SA_RESTART;
+    ::sigemptyset(&action.sa_mask);
+    if (::sigaction(inSignal, &action, nullptr) < 0)
+    {
+        LOG_ERROR("LoopWatchdog - sigaction({}) failed: {}\n", inSignal, errno);
+    }
+}
+
+/**
+ * @brief Frames of thread inThreadId, empty if it did not answer in time
+ */
+std::vector<std::string> captureStack(pid_t inThreadId, int inSignal)
+{
+    std::vector<std::string> stack;
+    std::lock_guard<std::mutex> lock(g_captureMutex);
+    g_frameCount.store(-1, std::memory_order_relaxed);
+    g_captureTarget.store(inThreadId, std::memory_order_release);
+    if (::syscall(SYS_tgkill, ::getpid(), inThreadId, inSignal) == 0)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + kCaptureTimeout;
+        while (g_frameCount.load(std::memory_order_acquire) < 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    g_captureTarget.store(0, std::memory_order_release);
+
+    const int frames = g_frameCount.load(std::memory_order_acquire);
+    if (frames > kHandlerFrames)
+    {
+        char **symbols = ::backtrace_symbols(g_frames + kHandlerFrames, frames - kHandlerFrames);
+        if (symbols != nullptr)
+        {
+            stack.assign(symbols, symbols + frames - kHandlerFrames);
+            ::free(symbols);
+        }
+    }
+    return stack;
+}
+
+/**
+ * @brief Readable form of a type_info::name(); lambdas come out as "Outer::function()::{lambda()#1}"
+ */
+std::string demangle(const char *inName)
+{
+    int status = 0;
+    char *readable = abi::__cxa_demangle(inName, nullptr, nullptr, &status);
+    if (readable == nullptr)
+    {
+        // Local types such as lambdas are named without the leading underscore
+        readable = abi::__cxa_demangle((std::string("_") + inName).c_str(), nullptr, nullptr, &status);
+    }
+    if (readable == nullptr)
+    {
+        return inName;
+    }
+    std::string result(readable);
+    ::free(readable);
+    return result;
+}
+
+const char* phaseName(uint8_t inPhase)
+{
+    switch (inPhase)
+    {
+    case LoopHeartbeat::kDispatching:
+        return "dispatching";
+    case LoopHeartbeat::kRunningFunctors:
+        return "functors";
+    case LoopHeartbeat::kFlushing:
+        return "flushing";
+    default:
+        return "polling";
+    }
+}
+
+}  // namespace
+
+LoopWatchdog::LoopWatchdog(double inThresholdSeconds)
+    : m_thresholdNs(static_cast<int64_t>(inThresholdSeconds * 1e9))
+    , m_callback(&LoopWatchdog::logStall)
+    , m_thread([this]() { threadFunc(); }, "LoopWatchdog")
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+LoopWatchdog& LoopWatchdog::watch(EventLoop *inLoop)
+{
+    m_loops.push_back(Watched{inLoop, 0});
+    return *this;
+}
+
+LoopWatchdog& LoopWatchdog::watch(const std::vector<EventLoop*> &inLoops)
+{
+    for (EventLoop *loop : inLoops)
+    {
+        watch(loop);
+    }
+    return *this;
+}
+
+LoopWatchdog& LoopWatchdog::setStackCapture(bool inEnabled, int inSignal)
+{
+    m_captureStacks = inEnabled;
+    m_signal = inSignal;
+    return *this;
+}
+
+LoopWatchdog& LoopWatchdog::setStallCallback(StallCallback inCallback)
+{
+    m_callback = std::move(inCallback);
+    return *this;
+}
+
+void LoopWatchdog::start()
+{
+    if (m_captureStacks)
+    {
+        installCaptureHandler(m_signal);
+    }
+    for (const Watched &watched : m_loops)
+    {
+        watched.loop->setStallThreshold(m_thresholdNs);
+    }
+    m_running = true;
+    m_thread.start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+        {
+            return;
+        }
+        m_running = false;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+    for (const Watched &watched : m_loops)
+    {
+        watched.loop->setStallThreshold(0);
+    }
+}
+
+void LoopWatchdog::threadFunc()
+{
+    const auto interval = std::chrono::nanoseconds(std::max<int64_t>(m_thresholdNs / 4, 1000000));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+        m_cond.wait_for(lock, interval);
+        lock.unlock();
+        const int64_t now = monotonicNanos();
+        for (Watched &watched : m_loops)
+        {
+            check(watched, now);
+        }
+        lock.lock();
+    }
+}
+
+void LoopWatchdog::check(Watched &ioWatched, int64_t inNow)
+{
+    const LoopHeartbeat &heartbeat = ioWatched.loop->heartbeat();
+    const int64_t busySince = heartbeat.busySince.load(std::memory_order_relaxed);
+    if (busySince == 0 || busySince == ioWatched.reportedSince || inNow - busySince <= m_thresholdNs)
+    {
+        return;
+    }
+
+    Stall stall;
+    stall.loop = ioWatched.loop;
+    stall.threadId = ioWatched.loop->threadId();
+    stall.phase = phaseName(heartbeat.phase.load(std::memory_order_relaxed));
+    stall.fd = heartbeat.fd.load(std::memory_order_relaxed);
+    stall.ownerId = heartbeat.ownerId.load(std::memory_order_relaxed);
+    const char *callback = heartbeat.callback.load(std::memory_order_relaxed);
+    if (m_captureStacks)
+    {
+        stall.stack = captureStack(stall.threadId, m_signal);
+    }
+    // The iteration may have finished while the fields were read
+    if (heartbeat.busySince.load(std::memory_order_relaxed) != busySince)
+    {
+        return;
+    }
+    ioWatched.reportedSince = busySince;
+    stall.busyNs = inNow - busySince;
+    if (callback != nullptr)
+    {
+        stall.callback = demangle(callback);
+    }
+    m_stallsReported.fetch_add(1, std::memory_order_relaxed);
+    m_callback(stall);
+}
+
+void LoopWatchdog::logStall(const Stall &inStall)
+{
+    std::string where(inStall.phase);
+    if (inStall.fd >= 0)
+    {
+        where += " fd " + std::to_string(inStall.fd);
+    }
+    if (inStall.ownerId != 0)
+    {
+        where += " of connection #" + std::to_string(inStall.ownerId);
+    }
+    if (!inStall.callback.empty())
+    {
+        where += " in " + inStall.callback;
+    }
+    LOG_ERROR("LoopWatchdog - EventLoop {} (thread {}) busy for {} ms, {}\n",
+              static_cast<void*>(inStall.loop), inStall.threadId, inStall.busyNs / 1000000, where);
+    for (size_t i = 0; i < inStall.stack.size(); ++i)
+    {
+        LOG_ERROR("LoopWatchdog -   #{} {}\n", i, inStall.stack[i]);
+    }
+}
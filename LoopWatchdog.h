@@ -0,0 +1,116 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief Thread reporting EventLoop iterations that run longer than a threshold
+ *
+ * A watched loop publishes a heartbeat: when its current iteration left poll
+ * and what it is running, i.e. the channel being dispatched (fd and owning
+ * connection id) or the type of the functor or timer callback. The watchdog
+ * samples the heartbeats every quarter threshold and reports an iteration once
+ * it has been busy for longer than the threshold, while it is still going on,
+ * so a callback that never returns is reported too. Each stall is reported once.
+ *
+ * With stack capture enabled the stalled thread is sent a signal whose handler
+ * records its stack with backtrace(3); link the program with -rdynamic to get
+ * function names. The handler is installed with SA_RESTART.
+ *
+ * The loops themselves record the exact duration of every iteration above the
+ * threshold in LoopMetricsSnapshot::stallNs, exported by MetricsServer.
+ *
+ * Typical use:
+ *   LoopWatchdog watchdog(0.1);
+ *   watchdog.watch(server.threadPool()->getAllLoops());
+ *   watchdog.start();
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    /**
+     * @brief One stall, as seen when it was detected
+     */
+    struct Stall
+    {
+        EventLoop *loop{nullptr};
+        pid_t threadId{0};
+        int64_t busyNs{0};              // iteration length at detection; the stall may go on
+        const char *phase{""};          // "dispatching", "functors" or "flushing"
+        int fd{-1};                     // channel being dispatched, -1 outside dispatch
+        uint64_t ownerId{0};            // TcpConnection id of that channel, 0 if none
+        std::string callback;           // demangled type of the functor or timer callback, empty if unknown
+        std::vector<std::string> stack; // frames of the loop thread, empty unless captured
+    };
+
+    using StallCallback = std::function<void(const Stall&)>;
+
+    /**
+     * @param inThresholdSeconds Iteration length reported as a stall
+     */
+    explicit LoopWatchdog(double inThresholdSeconds = 0.1);
+    ~LoopWatchdog();
+
+    /**
+     * @brief Watch inLoop; call before start()
+     */
+    LoopWatchdog& watch(EventLoop *inLoop);
+    LoopWatchdog& watch(const std::vector<EventLoop*> &inLoops);
+
+    /**
+     * @brief Capture the stack of stalled threads by sending them inSignal
+     * @details inSignal must not be used otherwise by the program. The default,
+     *          SIGURG, is ignored by default, so a late signal is harmless.
+     */
+    LoopWatchdog& setStackCapture(bool inEnabled, int inSignal = SIGURG);
+
+    /**
+     * @brief Replace the default report (LOG_ERROR); runs in the watchdog thread
+     */
+    LoopWatchdog& setStallCallback(StallCallback inCallback);
+
+    void start();
+
+    /**
+     * @brief Stop the watchdog thread and stop the loops publishing their heartbeat
+     */
+    void stop();
+
+    [[nodiscard]] uint64_t stallsReported() const noexcept
+    { return m_stallsReported.load(std::memory_order_relaxed); }
+
+private:
+    struct Watched
+    {
+        EventLoop *loop;
+        int64_t reportedSince;  // busySince of the last stall reported
+    };
+
+    void threadFunc();
+    void check(Watched &ioWatched, int64_t inNow);
+    static void logStall(const Stall &inStall);
+
+    const int64_t m_thresholdNs;
+    std::vector<Watched> m_loops;
+    bool m_captureStacks{false};
+    int m_signal{SIGURG};
+    StallCallback m_callback;
+    std::atomic<uint64_t> m_stallsReported{0};
+
+    bool m_running{false};  // guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    muduoModernCpp::Thread m_thread;
+};
@@ -0,0 +1,459 @@
+#include "MetricsServer.h"
+#include "Logger.h"
+
+#include <cstdio>
+
+namespace
+{
+constexpr size_t kMaxRequestBytes = 8 * 1024;
+constexpr const char *kContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+/**
+ * @brief What one scrape learned about one registered server
+ */
+struct ServerSample
+{
+    std::string name;
+    size_t connections{0};
+    Acceptor::Stats accept;
+    uint64_t admissionRejected{0};
+    std::shared_ptr<OutputBudget> budget;
+    std::vector<TcpServer::LoopStats> loops;
+};
+
+/**
+ * @brief A scrape waiting for the io loops to answer; admin loop only
+ */
+struct Scrape
+{
+    std::vector<ServerSample> servers;
+    size_t remaining{0};
+    std::shared_ptr<std::vector<MetricsServer::CustomMetric>> metrics;
+    std::weak_ptr<TcpConnection> conn;
+};
+
+/**
+ * @brief Prometheus text exposition format writer
+ */
+class Exposition
+{
+public:
+    void family(const char *inName, const char *inHelp, const char *inType)
+    {
+        m_out.append("# HELP ").append(inName).append(" ").append(inHelp).append("\n");
+        m_out.append("# TYPE ").append(inName).append(" ").append(inType).append("\n");
+    }
+
+    void sample(const char *inName, const std::string &inLabels, uint64_t inValue)
+    {
+        beginSample(inName, inLabels);
+        m_out.append(std::to_string(inValue)).append("\n");
+    }
+
+    void sample(const char *inName, const std::string &inLabels, double inValue)
+    {
+        beginSample(inName, inLabels);
+        char buf[32];
+        const int n = snprintf(buf, sizeof(buf), "%.9g", inValue);
+        m_out.append(buf, n > 0 ? static_cast<size_t>(n) : 0).append("\n");
+    }
+
+    /**
+     * @brief Cumulative buckets at powers of two of a LogLinearHistogram
+     * @param inNanoseconds Values are durations in ns, exported in seconds; otherwise counts
+     */
+    void histogram(const std::string &inName, const std::string &inLabels,
+                   const HistogramSnapshot &inHistogram, bool inNanoseconds)
+    {
+        // Bucket boundaries fall on powers of two, so "below 2^k" is exact
+        const int firstExponent = inNanoseconds ? 10 : 0;  // 1us, or 0 events
+        const int lastExponent = inNanoseconds ? 34 : 12;  // ~17s, or 4095 events
+        const int step = inNanoseconds ? 2 : 1;
+        const std::string bucketName = inName + "_bucket";
+        const std::string separator = inLabels.empty() ? "" : ",";
+
+        uint64_t cumulative = 0;
+        size_t index = 0;
+        for (int exponent = firstExponent; exponent <= lastExponent; exponent += step)
+        {
+            const uint64_t limit = uint64_t{1} << exponent;
+            const size_t end = HistogramSnapshot::bucketFor(limit);
+            for (; index < end; ++index)
+            {
+                cumulative += inHistogram.counts[index];
+            }
+            char le[32];
+            if (inNanoseconds)
+            {
+                snprintf(le, sizeof(le), "%.9g", static_cast<double>(limit) * 1e-9);
+            }
+            else
+            {
+                snprintf(le, sizeof(le), "%lu", static_cast<unsigned long>(limit - 1));
+            }
+            sample(bucketName.c_str(), inLabels + separator + "le=\"" + le + "\"", cumulative);
+        }
+        sample(bucketName.c_str(), inLabels + separator + "le=\"+Inf\"", inHistogram.count);
+        if (inNanoseconds)
+        {
+            sample((inName + "_sum").c_str(), inLabels, static_cast<double>(inHistogram.sum) * 1e-9);
+        }
+        else
+        {
+            sample((inName + "_sum").c_str(), inLabels, inHistogram.sum);
+        }
+        sample((inName + "_count").c_str(), inLabels, inHistogram.count);
+    }
+
+    std::string take() { return std::move(m_out); }
+
+private:
+    void beginSample(const char *inName, const std::string &inLabels)
+    {
+        m_out.append(inName);
+        if (!inLabels.empty())
+        {
+            m_out.append("{").append(inLabels).append("}");
+        }
+        m_out.append(" ");
+    }
+
+    std::string m_out;
+};
+
+std::string escapeLabel(const std::string &inValue)
+{
+    std::string escaped;
+    escaped.reserve(inValue.size());
+    for (char c : inValue)
+    {
+        if (c == '\\' || c == '"')
+        {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        else if (c == '\n')
+        {
+            escaped.append("\\n");
+        }
+        else
+        {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+std::string serverLabels(const ServerSample &inServer)
+{
+    return "server=\"" + escapeLabel(inServer.name) + "\"";
+}
+
+std::string loopLabels(const ServerSample &inServer, size_t inLoop)
+{
+    return serverLabels(inServer) + ",loop=\"" + std::to_string(inLoop) + "\"";
+}
+
+struct ServerMetric
+{
+    const char *name;
+    const char *help;
+    const char *type;
+    uint64_t (*value)(const ServerSample&);
+};
+
+const ServerMetric kServerMetrics[] = {
+    {"muduo_server_connections", "Live connections.", "gauge",
+     [](const ServerSample &s) -> uint64_t { return s.connections; }},
+    {"muduo_server_accepted_total", "Connections accepted.", "counter",
+     [](const ServerSample &s) -> uint64_t { return s.accept.accepted; }},
+    {"muduo_server_accept_fd_rejected_total", "Connections closed because the process ran out of fds.", "counter",
+     [](const ServerSample &s) -> uint64_t { return s.accept.rejected; }},
+    {"muduo_server_accept_batches_total", "Readiness events that accepted at least one connection.", "counter",
+     [](const ServerSample &s) -> uint64_t { return s.accept.batches; }},
+    {"muduo_server_admission_rejected_total", "Connections closed on arrival because a connection limit was reached.", "counter",
+     [](const ServerSample &s) -> uint64_t { return s.admissionRejected; }},
+};
+
+struct LoopMetric
+{
+    const char *name;
+    const char *help;
+    const char *type;
+    double (*value)(const TcpServer::LoopStats&);
+};
+
+const LoopMetric kLoopMetrics[] = {
+    {"muduo_loop_iterations_total", "Event loop iterations.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.metrics.iterations); }},
+    {"muduo_loop_events_total", "Active channels returned by poll.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.metrics.eventsHandled); }},
+    {"muduo_loop_functors_total", "Pending functors run.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.metrics.functorsRun); }},
+    {"muduo_loop_wakeups_total", "Wakeups of the loop by other threads.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.metrics.wakeups); }},
+    {"muduo_loop_connections", "Live connections owned by the loop.", "gauge",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.connections); }},
+    {"muduo_connection_read_bytes_total", "Bytes read from connections.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.bytesRead); }},
+    {"muduo_connection_written_bytes_total", "Bytes written to connections.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.bytesWritten); }},
+    {"muduo_connection_read_syscalls_total", "Read syscalls on connections.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.readCalls); }},
+    {"muduo_connection_write_syscalls_total", "Write syscalls on connections.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.writeCalls); }},
+    {"muduo_connection_message_callbacks_total", "MessageCallback invocations.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.messageCallbacks); }},
+    {"muduo_connection_message_callback_seconds_total", "Time spent in MessageCallbacks.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.messageCallbackNs) * 1e-9; }},
+    {"muduo_connection_high_water_mark_total", "Output buffers reaching the high water mark.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.highWaterMarkCrossings); }},
+    {"muduo_connection_over_high_water_mark_seconds_total", "Time output buffers spent above the high water mark.", "counter",
+     [](const TcpServer::LoopStats &l) { return static_cast<double>(l.traffic.overHighWaterMarkNs) * 1e-9; }},
+};
+
+struct LoopHistogram
+{
+    const char *name;
+    const char *help;
+    HistogramSnapshot LoopMetricsSnapshot::*histogram;
+    bool nanoseconds;
+};
+
+const LoopHistogram kLoopHistograms[] = {
+    {"muduo_loop_poll_wait_seconds", "Time blocked in poll per iteration.",
+     &LoopMetricsSnapshot::pollWaitNs, true},
+    {"muduo_loop_dispatch_seconds", "Duration of one Channel::handleEvent.",
+     &LoopMetricsSnapshot::dispatchNs, true},
+    {"muduo_loop_functors_seconds", "Duration of the pending functor phase per iteration.",
+     &LoopMetricsSnapshot::functorsNs, true},
+    {"muduo_loop_stall_seconds", "Iterations longer than the LoopWatchdog threshold.",
+     &LoopMetricsSnapshot::stallNs, true},
+    {"muduo_loop_events_per_poll", "Active channels per iteration.",
+     &LoopMetricsSnapshot::eventsPerPoll, false},
+    {"muduo_loop_queue_depth", "Functors waiting when an iteration picks them up.",
+     &LoopMetricsSnapshot::queueDepth, false},
+};
+
+struct LoopPerfCounter
+{
+    const char *name;
+    const char *help;
+    uint64_t PerfCounts::*counter;
+};
+
+const LoopPerfCounter kLoopPerfCounters[] = {
+    {"muduo_loop_perf_cycles_total", "CPU cycles per loop phase, with performance counters enabled.",
+     &PerfCounts::cycles},
+    {"muduo_loop_perf_instructions_total", "Instructions retired per loop phase, with performance counters enabled.",
+     &PerfCounts::instructions},
+    {"muduo_loop_perf_cache_misses_total", "Cache misses per loop phase, with performance counters enabled.",
+     &PerfCounts::cacheMisses},
+    {"muduo_loop_perf_context_switches_total", "Context switches per loop phase, with performance counters enabled.",
+     &PerfCounts::contextSwitches},
+};
+
+std::string render(const Scrape &inScrape)
+{
+    Exposition out;
+    for (const ServerMetric &metric : kServerMetrics)
+    {
+        out.family(metric.name, metric.help, metric.type);
+        for (const ServerSample &server : inScrape.servers)
+        {
+            out.sample(metric.name, serverLabels(server), metric.value(server));
+        }
+    }
+    out.family("muduo_server_output_buffered_bytes", "Bytes buffered in connection output buffers.", "gauge");
+    for (const ServerSample &server : inScrape.servers)
+    {
+        if (server.budget)
+        {
+            out.sample("muduo_server_output_buffered_bytes", serverLabels(server),
+                       static_cast<uint64_t>(server.budget->bufferedBytes()));
+        }
+    }
+
+    for (const LoopMetric &metric : kLoopMetrics)
+    {
+        out.family(metric.name, metric.help, metric.type);
+        for (const ServerSample &server : inScrape.servers)
+        {
+            for (size_t i = 0; i < server.loops.size(); ++i)
+            {
+                out.sample(metric.name, loopLabels(server, i), metric.value(server.loops[i]));
+            }
+        }
+    }
+    for (const LoopHistogram &histogram : kLoopHistograms)
+    {
+        out.family(histogram.name, histogram.help, "histogram");
+        for (const ServerSample &server : inScrape.servers)
+        {
+            for (size_t i = 0; i < server.loops.size(); ++i)
+            {
+                out.histogram(histogram.name, loopLabels(server, i),
+                              server.loops[i].metrics.*histogram.histogram, histogram.nanoseconds);
+            }
+        }
+    }
+
+    // Only loops that sampled performance counters; the ratios per event are left to PromQL
+    out.family("muduo_loop_perf_events_total", "Channels dispatched while performance counters were enabled.", "counter");
+    for (const ServerSample &server : inScrape.servers)
+    {
+        for (size_t i = 0; i < server.loops.size(); ++i)
+        {
+            if (server.loops[i].metrics.perfIterations > 0)
+            {
+                out.sample("muduo_loop_perf_events_total", loopLabels(server, i), server.loops[i].metrics.perfEvents);
+            }
+        }
+    }
+    for (const LoopPerfCounter &metric : kLoopPerfCounters)
+    {
+        out.family(metric.name, metric.help, "counter");
+        for (const ServerSample &server : inScrape.servers)
+        {
+            for (size_t i = 0; i < server.loops.size(); ++i)
+            {
+                const LoopMetricsSnapshot &metrics = server.loops[i].metrics;
+                if (metrics.perfIterations > 0)
+                {
+                    const std::string labels = loopLabels(server, i);
+                    out.sample(metric.name, labels + ",phase=\"poll\"", metrics.pollCounters.*metric.counter);
+                    out.sample(metric.name, labels + ",phase=\"dispatch\"", metrics.dispatchCounters.*metric.counter);
+                }
+            }
+        }
+    }
+
+    out.family("muduo_log_lines_total", "Lines written by the Logger.", "counter");
+    for (int level = DEBUG; level <= FATAL; ++level)
+    {
+        std::string name = Logger::levelName(level);  // "[INFO]"
+        name = name.substr(1, name.size() - 2);
+        out.sample("muduo_log_lines_total", "level=\"" + name + "\"", Logger::instance().linesLogged(level));
+    }
+    out.family("muduo_binary_log_dropped_records_total", "BinaryLog records dropped because a ring was full.", "counter");
+    out.sample("muduo_binary_log_dropped_records_total", "", BinaryLog::instance().droppedRecords());
+
+    for (const MetricsServer::CustomMetric &metric : *inScrape.metrics)
+    {
+        out.family(metric.name.c_str(), metric.help.c_str(), metric.type.c_str());
+        out.sample(metric.name.c_str(), "", metric.value());
+    }
+    return out.take();
+}
+
+void respond(const TcpConnectionPtr &inConn, const char *inStatus, const char *inContentType, const std::string &inBody)
+{
+    std::string response = "HTTP/1.1 ";
+    response.append(inStatus).append("\r\nContent-Type: ").append(inContentType);
+    response.append("\r\nContent-Length: ").append(std::to_string(inBody.size()));
+    response.append("\r\nConnection: close\r\n\r\n").append(inBody);
+    inConn->send(response);
+    inConn->shutdown();
+}
+}  // namespace
+
+MetricsServer::MetricsServer(EventLoop *inLoop, const InetAddress &inListenAddr, const std::string &inName)
+    : m_loop(inLoop)
+    , m_server(inLoop, inListenAddr, inName)
+    , m_metrics(std::make_shared<std::vector<CustomMetric>>())
+{
+    m_server.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buffer, Timestamp receiveTime) {
+        onMessage(conn, buffer, receiveTime);
+    });
+}
+
+MetricsServer& MetricsServer::addServer(TcpServer *inServer)
+{
+    inServer->threadPool()->setMetricsEnabled(true);
+    m_targets.push_back(inServer);
+    return *this;
+}
+
+MetricsServer& MetricsServer::addMetric(std::string inName, std::string inHelp, std::string inType, ValueFunc inValue)
+{
+    m_metrics->push_back({std::move(inName), std::move(inHelp), std::move(inType), std::move(inValue)});
+    return *this;
+}
+
+void MetricsServer::start()
+{
+    m_server.start();
+}
+
+void MetricsServer::onMessage(const TcpConnectionPtr &inConn, Buffer *inBuffer, Timestamp)
+{
+    if (inBuffer->find("\r\n\r\n") == nullptr)
+    {
+        if (inBuffer->readableBytes() > kMaxRequestBytes)
+        {
+            inBuffer->retrieveAll();
+            respond(inConn, "400 Bad Request", "text/plain", "request too large\n");
+        }
+        return;
+    }
+
+    // One request per connection, answered with "Connection: close"
+    const std::string_view request(inBuffer->peek(), inBuffer->findCRLF() - inBuffer->peek());
+    const bool isGet = request.substr(0, 4) == "GET ";
+    const std::string_view target = isGet ? request.substr(4, request.find(' ', 4) - 4) : std::string_view();
+    const bool isMetrics = target == "/metrics" || target.substr(0, 9) == "/metrics?";
+    inBuffer->retrieveAll();
+
+    if (!isGet)
+    {
+        respond(inConn, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+    }
+    else if (!isMetrics)
+    {
+        respond(inConn, "404 Not Found", "text/plain", "try /metrics\n");
+    }
+    else
+    {
+        scrape(inConn);
+    }
+}
+
+void MetricsServer::scrape(const TcpConnectionPtr &inConn)
+{
+    auto scrape = std::make_shared<Scrape>();
+    scrape->metrics = m_metrics;
+    scrape->conn = inConn;
+    scrape->remaining = m_targets.size();
+    scrape->servers.resize(m_targets.size());
+
+    auto finish = [](const Scrape &inScrape) {
+        if (TcpConnectionPtr conn = inScrape.conn.lock())
+        {
+            respond(conn, "200 OK", kContentType, render(inScrape));
+        }
+    };
+    if (m_targets.empty())
+    {
+        finish(*scrape);
+        return;
+    }
+
+    for (size_t i = 0; i < m_targets.size(); ++i)
+    {
+        TcpServer *target = m_targets[i];
+        ServerSample &server = scrape->servers[i];
+        server.name = target->getName();
+        server.connections = target->connectionCount();
+        server.accept = target->acceptStats();
+        server.admissionRejected = target->admissionRejectedCount();
+        server.budget = target->outputBudget();
+
+        target->collectLoopStats(m_loop, [scrape, i, finish](std::vector<TcpServer::LoopStats> loops) {
+            scrape->servers[i].loops = std::move(loops);
+            if (--scrape->remaining == 0)
+            {
+                finish(*scrape);
+            }
+        });
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Admin endpoint answering "GET /metrics" in the Prometheus text format
+ *
+ * Runs a single-loop TcpServer of its own on inLoop. Every scrape asks each io
+ * loop of the registered servers for a snapshot through
+ * TcpServer::collectLoopStats and renders the response once all loops have
+ * answered, so the connection and loop hot paths never take a lock for it.
+ * Server counters, Logger line counts, BinaryLog drops and metrics added with
+ * addMetric() are read from the admin loop.
+ *
+ * Typical use:
+ *   MetricsServer metrics(&baseLoop, InetAddress(9100));
+ *   metrics.addServer(&server);
+ *   metrics.start();
+ */
+class MetricsServer : noncopyable
+{
+public:
+    using ValueFunc = std::function<double()>;
+
+    /**
+     * @brief Metric exported through addMetric()
+     */
+    struct CustomMetric
+    {
+        std::string name;
+        std::string help;
+        std::string type;
+        ValueFunc value;
+    };
+
+    /**
+     * @param inLoop Loop serving scrapes, usually the base loop
+     * @param inListenAddr Admin address, e.g. InetAddress(9100, "127.0.0.1")
+     */
+    MetricsServer(EventLoop *inLoop, const InetAddress &inListenAddr, const std::string &inName = "metrics");
+
+    /**
+     * @brief Export inServer's accept, admission, loop and connection statistics
+     * @details Also enables loop metrics on its thread pool. inServer must outlive
+     *          this object. Call before start().
+     */
+    MetricsServer& addServer(TcpServer *inServer);
+
+    /**
+     * @brief Export a value sampled in the admin loop on every scrape
+     * @param inName Prometheus metric name, e.g. "app_async_log_dropped_bytes_total"
+     * @param inType "counter" or "gauge"
+     */
+    MetricsServer& addMetric(std::string inName, std::string inHelp, std::string inType, ValueFunc inValue);
+
+    void start();
+
+    /**
+     * @brief Address the admin server listens on, e.g. "127.0.0.1:9100"
+     */
+    [[nodiscard]] const std::string& getIpPort() const noexcept { return m_server.getIpPort(); }
+
+private:
+    void onMessage(const TcpConnectionPtr &inConn, Buffer *inBuffer, Timestamp inReceiveTime);
+
+    /**
+     * @brief Fan out to the registered servers and answer inConn once all loops replied
+     */
+    void scrape(const TcpConnectionPtr &inConn);
+
+    EventLoop* const m_loop;
+    TcpServer m_server;
+    std::vector<TcpServer*> m_targets;
+    // Shared with scrapes in flight, which may complete after this object is gone
+    std::shared_ptr<std::vector<CustomMetric>> m_metrics;
+};
@@ -0,0 +1,275 @@
+#include "MmapLogFile.h"
+#include "LogFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+MmapLogFile::MmapLogFile(std::string inBasename,
+                         size_t inRollSize,
+                         int inRollIntervalSeconds,
+                         int inFlushIntervalSeconds)
+    : m_basename(std::move(inBasename))
+    , m_rollSize(inRollSize)
+    , m_rollIntervalSeconds(inRollIntervalSeconds)
+    , m_flushIntervalSeconds(inFlushIntervalSeconds)
+    , m_thread([this]() { threadFunc(); }, "MmapLogFile")
+{
+    Window *first = openWindow();
+    if (first != nullptr)
+    {
+        activate(first);
+        m_current.store(first, std::memory_order_release);
+    }
+    m_standby.store(openWindow(), std::memory_order_release);
+}
+
+MmapLogFile::~MmapLogFile()
+{
+    stop();
+}
+
+void MmapLogFile::start()
+{
+    m_running = true;
+    m_thread.start();
+}
+
+void MmapLogFile::stop()
+{
+    if (m_running)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cond.notify_one();
+        m_thread.join();
+    }
+
+    Window *current = m_current.exchange(nullptr, std::memory_order_acq_rel);
+    if (current != nullptr)
+    {
+        current->sealedAt = current->cursor.fetch_add(kSealed, std::memory_order_acq_rel);
+        m_sealed.push_back(current);
+    }
+    for (Window *window : m_sealed)
+    {
+        closeWindow(window);
+    }
+    m_sealed.clear();
+
+    Window *standby = m_standby.exchange(nullptr, std::memory_order_acq_rel);
+    if (standby != nullptr)
+    {
+        ::munmap(standby->base, standby->size);
+        ::close(standby->fd);
+        ::unlink(standby->fileName.c_str());
+    }
+}
+
+void MmapLogFile::append(const char *inLine, size_t inLen)
+{
+    // A replaced window is only given up after one roll-over attempt, so a line
+    // is never retried more than twice
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        Window *window = m_current.load(std::memory_order_acquire);
+        if (window == nullptr || inLen > window->size)
+        {
+            break;
+        }
+        const uint64_t offset = window->cursor.fetch_add(inLen, std::memory_order_relaxed);
+        if (offset + inLen <= window->size)
+        {
+            std::memcpy(window->base + offset, inLine, inLen);
+            window->committed.fetch_add(inLen, std::memory_order_release);
+            return;
+        }
+        if (offset < window->size)
+        {
+            // Only the line crossing the end gets here: the file ends where it would have started
+            window->validEnd.store(offset, std::memory_order_relaxed);
+            window->committed.fetch_add(window->size - offset, std::memory_order_release);
+        }
+        if (m_current.load(std::memory_order_acquire) == window && !rollOver())
+        {
+            break;
+        }
+    }
+    m_droppedBytes.fetch_add(inLen, std::memory_order_relaxed);
+}
+
+void MmapLogFile::flush()
+{
+    Window *window = m_current.load(std::memory_order_acquire);
+    if (window != nullptr)
+    {
+        ::msync(window->base, window->size, MS_ASYNC);
+    }
+}
+
+bool MmapLogFile::rollOver()
+{
+    Window *next = m_standby.exchange(nullptr, std::memory_order_acq_rel);
+    if (next == nullptr)
+    {
+        // Another writer is rolling over, or the background thread could not
+        // prepare a file: let the caller retry once
+        m_cond.notify_one();
+        return m_current.load(std::memory_order_acquire) != nullptr;
+    }
+    Window *old = m_current.exchange(next, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (old != nullptr)
+        {
+            // Later reservations land past the end and move on to the new window
+            old->sealedAt = old->cursor.fetch_add(kSealed, std::memory_order_acq_rel);
+            m_sealed.push_back(old);
+        }
+    }
+    m_cond.notify_one();
+    return true;
+}
+
+MmapLogFile::Window* MmapLogFile::openWindow()
+{
+    auto window = std::make_unique<Window>();
+    window->fileName = m_basename + ".next." + std::to_string(::getpid()) + "."
+                       + std::to_string(m_windows.size()) + ".log";
+    window->size = m_rollSize;
+    window->fd = ::open(window->fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (window->fd < 0)
+    {
+        // No Logger here: the logger may be the one writing to this file
+        fprintf(stderr, "MmapLogFile: cannot open %s\n", window->fileName.c_str());
+        return nullptr;
+    }
+    // Reserve the blocks now: running out of disk later would raise SIGBUS in a writer
+    const int err = ::posix_fallocate(window->fd, 0, static_cast<off_t>(m_rollSize));
+    void *base = err == 0 ? ::mmap(nullptr, m_rollSize, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, window->fd, 0)
+                          : MAP_FAILED;
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "MmapLogFile: cannot map %zu bytes of %s\n", m_rollSize, window->fileName.c_str());
+        ::close(window->fd);
+        ::unlink(window->fileName.c_str());
+        return nullptr;
+    }
+    window->base = static_cast<char*>(base);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_windows.push_back(std::move(window));
+    return m_windows.back().get();
+}
+
+void MmapLogFile::activate(Window *inWindow)
+{
+    const std::string fileName = LogFile::makeFileName(m_basename, ++m_sequence);
+    if (::rename(inWindow->fileName.c_str(), fileName.c_str()) == 0)
+    {
+        inWindow->fileName = fileName;
+    }
+    inWindow->activatedAt = ::time(nullptr);
+}
+
+void MmapLogFile::closeWindow(Window *inWindow)
+{
+    if (inWindow->activatedAt == 0)
+    {
+        activate(inWindow);  // replaced again before the background thread saw it
+    }
+    const uint64_t reserved = std::min<uint64_t>(inWindow->sealedAt, inWindow->size);
+    while (inWindow->committed.load(std::memory_order_acquire) < reserved)
+    {
+        std::this_thread::yield();  // a writer is still copying into this window
+    }
+    const uint64_t validEnd = inWindow->validEnd.load(std::memory_order_relaxed);
+    const uint64_t end = validEnd != kNoEnd ? validEnd : reserved;
+
+    ::msync(inWindow->base, inWindow->size, MS_ASYNC);
+    ::munmap(inWindow->base, inWindow->size);
+    inWindow->base = nullptr;
+    if (::ftruncate(inWindow->fd, static_cast<off_t>(end)) != 0)
+    {
+        fprintf(stderr, "MmapLogFile: cannot truncate %s\n", inWindow->fileName.c_str());
+    }
+    ::close(inWindow->fd);
+    inWindow->fd = -1;
+    m_closedFiles.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MmapLogFile::threadFunc()
+{
+    auto lastFlush = std::chrono::steady_clock::now();
+    while (true)
+    {
+        std::vector<Window*> sealed;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_sealed.empty() && m_running)
+            {
+                // Wake at least every second to check the roll interval
+                m_cond.wait_for(lock, std::chrono::seconds(1));
+            }
+            if (!m_running)
+            {
+                break;
+            }
+            sealed.swap(m_sealed);
+        }
+
+        // Name files in the order they became current
+        for (Window *window : sealed)
+        {
+            if (window->activatedAt == 0)
+            {
+                activate(window);
+            }
+        }
+        Window *current = m_current.load(std::memory_order_acquire);
+        if (current != nullptr && current->activatedAt == 0)
+        {
+            activate(current);
+        }
+        for (Window *window : sealed)
+        {
+            closeWindow(window);
+        }
+        if (m_standby.load(std::memory_order_acquire) == nullptr)
+        {
+            m_standby.store(openWindow(), std::memory_order_release);
+        }
+
+        if (current != nullptr && m_rollIntervalSeconds > 0
+            && ::time(nullptr) - current->activatedAt >= m_rollIntervalSeconds
+            && current->cursor.load(std::memory_order_relaxed) > 0)
+        {
+            rollOver();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush >= std::chrono::seconds(m_flushIntervalSeconds))
+        {
+            lastFlush = now;
+            current = m_current.load(std::memory_order_acquire);
+            if (current != nullptr && current->activatedAt != 0)
+            {
+                const size_t committed = current->committed.load(std::memory_order_acquire);
+                if (committed > current->synced)
+                {
+                    ::msync(current->base, current->size, MS_ASYNC);
+                    current->synced = committed;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Rolling log files written through shared memory mappings
+ *
+ * Each file is preallocated to the roll size and mapped MAP_SHARED. append()
+ * reserves space by advancing an atomic cursor and copies the line into the
+ * mapping: no lock and no syscall on the logging thread. Because the pages
+ * belong to the page cache, everything appended survives a crash of the process.
+ *
+ * A background thread keeps the next file mapped and ready, so rolling is a
+ * pointer swap done by the writer that fills the current file (or by the
+ * background thread once the roll interval has passed). The background thread
+ * then waits for in-flight copies into the old file, msyncs it, truncates it to
+ * the bytes actually written and closes it; it also msyncs the active file
+ * every flush interval.
+ *
+ * Files are named like LogFile's, with a sequence number after the pid. A line
+ * that does not fit in an empty file, or that arrives while no next file could
+ * be prepared (e.g. the disk is full), is dropped and counted. After a crash
+ * the last file keeps its preallocated size; the log ends at the first NUL byte.
+ *
+ * Typical use:
+ *   MmapLogFile log("server");
+ *   log.start();
+ *   Logger::instance().setOutput([&log](const char *msg, size_t len) { log.append(msg, len); });
+ *   Logger::instance().setFlush([&log]() { log.flush(); });
+ */
+class MmapLogFile : noncopyable
+{
+public:
+    /**
+     * @param inBasename Log file basename, see LogFile
+     * @param inRollSize File size at which writers move on to the next file
+     * @param inRollIntervalSeconds Age at which a non-empty file is rolled, 0 to roll by size only
+     * @param inFlushIntervalSeconds Interval between msyncs of the active file
+     */
+    explicit MmapLogFile(std::string inBasename,
+                         size_t inRollSize = 64 * 1024 * 1024,
+                         int inRollIntervalSeconds = 24 * 60 * 60,
+                         int inFlushIntervalSeconds = 3);
+    ~MmapLogFile();
+
+    /**
+     * @brief Copy one formatted line into the active file; thread-safe and lock-free
+     */
+    void append(const char *inLine, size_t inLen);
+
+    /**
+     * @brief Schedule write-back of the active file (msync MS_ASYNC)
+     */
+    void flush();
+
+    void start();
+
+    /**
+     * @brief Stop the background thread and close all files
+     * @note The Logger output must be detached first; append() after stop() drops lines
+     */
+    void stop();
+
+    [[nodiscard]] uint64_t droppedBytes() const noexcept
+    { return m_droppedBytes.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t closedFiles() const noexcept
+    { return m_closedFiles.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @brief One mapped log file
+     */
+    struct Window
+    {
+        std::string fileName;
+        int fd{-1};
+        char *base{nullptr};
+        size_t size{0};
+        int64_t activatedAt{0};                     // seconds, background thread only
+        size_t synced{0};                           // bytes msynced, background thread only
+        std::atomic<uint64_t> cursor{0};            // bytes reserved by writers
+        std::atomic<uint64_t> committed{0};         // bytes copied (or given up) by writers
+        std::atomic<uint64_t> validEnd{kNoEnd};     // where a line that did not fit would have started
+        uint64_t sealedAt{0};                       // bytes reserved when the window was replaced
+    };
+
+    static constexpr uint64_t kNoEnd = ~uint64_t{0};
+    static constexpr uint64_t kSealed = uint64_t{1} << 62;  // added to a replaced window's cursor
+
+    Window* openWindow();
+
+    /**
+     * @brief Make the prepared window current and queue the replaced one for closing
+     * @return false if no window was prepared
+     */
+    bool rollOver();
+
+    /**
+     * @brief Unmap a sealed window once all writers are done with it; background thread only
+     */
+    void closeWindow(Window *inWindow);
+    void activate(Window *inWindow);
+    void threadFunc();
+
+    const std::string m_basename;
+    const size_t m_rollSize;
+    const int m_rollIntervalSeconds;
+    const int m_flushIntervalSeconds;
+
+    std::atomic<Window*> m_current{nullptr};
+    std::atomic<Window*> m_standby{nullptr};
+    std::atomic<uint64_t> m_droppedBytes{0};
+    std::atomic<uint64_t> m_closedFiles{0};
+
+    std::atomic<bool> m_running{false};
+    muduoModernCpp::Thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Window*> m_sealed;                  // replaced windows waiting to be closed
+    // Windows are kept until destruction: a writer may still hold a pointer to a
+    // replaced one. Each costs a few dozen bytes once its mapping is released.
+    std::vector<std::unique_ptr<Window>> m_windows;
+    int m_sequence{0};                              // background thread only once started
+};
@@ -0,0 +1,96 @@
+#include "OutputBudget.h"
+#include "Logger.h"
+
+namespace
+{
+void notifyOverload(const std::shared_ptr<const OutputBudget::OverloadCallback> &inCallback, bool inOverloaded)
+{
+    if (inCallback)
+    {
+        (*inCallback)(inOverloaded);
+    }
+}
+}  // namespace
+
+OutputBudget::OutputBudget(size_t inLimitBytes, double inHighRatio, double inLowRatio)
+    : m_limit(inLimitBytes)
+    , m_highMark(static_cast<size_t>(inLimitBytes * inHighRatio))
+    , m_lowMark(static_cast<size_t>(inLimitBytes * inLowRatio))
+{
+}
+
+void OutputBudget::registerLoops(const std::vector<EventLoop*> &inLoops)
+{
+    m_slots.clear();
+    for (EventLoop *loop : inLoops)
+    {
+        auto slot = std::make_unique<Slot>();
+        slot->loop = loop;
+        m_slots.push_back(std::move(slot));
+    }
+}
+
+OutputBudget::Slot* OutputBudget::slotFor(EventLoop *inLoop) const
+{
+    for (const auto &slot : m_slots)
+    {
+        if (slot->loop == inLoop)
+        {
+            return slot.get();
+        }
+    }
+    return nullptr;
+}
+
+void OutputBudget::setOverloadCallback(OverloadCallback inCb)
+{
+    std::shared_ptr<const OverloadCallback> callback;
+    if (inCb)
+    {
+        callback = std::make_shared<const OverloadCallback>(std::move(inCb));
+    }
+    std::atomic_store(&m_overloadCallback, std::move(callback));
+}
+
+size_t OutputBudget::bufferedBytes() const
+{
+    int64_t total = 0;
+    for (const auto &slot : m_slots)
+    {
+        total += slot->bytes.load(std::memory_order_relaxed);
+    }
+    return total > 0 ? static_cast<size_t>(total) : 0;
+}
+
+void OutputBudget::charge(Slot *inSlot, int64_t inDelta)
+{
+    if (inDelta == 0)
+    {
+        return;
+    }
+    inSlot->bytes.fetch_add(inDelta, std::memory_order_relaxed);
+
+    // Only growth can overload and only shrinking can recover, so the
+    // cross-loop sum is skipped for the other direction
+    const bool wasOverloaded = overloaded();
+    if (inDelta > 0 && !wasOverloaded)
+    {
+        const size_t total = bufferedBytes();
+        bool expected = false;
+        if (total >= m_highMark && m_overloaded.compare_exchange_strong(expected, true))
+        {
+            LOG_ERROR("OutputBudget overloaded: {} of {} bytes buffered \n", total, m_limit);
+            notifyOverload(std::atomic_load(&m_overloadCallback), true);
+        }
+    }
+    else if (inDelta < 0 && wasOverloaded)
+    {
+        const size_t total = bufferedBytes();
+        bool expected = true;
+        if (total <= m_lowMark && m_overloaded.compare_exchange_strong(expected, false))
+        {
+            LOG_INFO("OutputBudget recovered: {} of {} bytes buffered \n", total, m_limit);
+            notifyOverload(std::atomic_load(&m_overloadCallback), false);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * @brief Server-wide accountant for bytes buffered in connection output buffers
+ *
+ * Each EventLoop gets its own cache-line sized counter, so connections only ever
+ * touch the counter of the loop they live in. The total is the sum over all loops
+ * and is only evaluated when a change could flip the overload state.
+ *
+ * The budget is overloaded once the total reaches the high mark and recovers when
+ * it drops to the low mark; each transition invokes the OverloadCallback once,
+ * from the io thread that caused it. Transitions on different threads may be
+ * reported out of order, so a reaction deferred to another thread should read
+ * overloaded() when it runs instead of trusting the argument.
+ */
+class OutputBudget : noncopyable
+{
+public:
+    /**
+     * @brief What TcpServer does while the budget is overloaded
+     */
+    enum class ShedPolicy
+    {
+        None,           // only report through the overload callback
+        PauseReads,     // stop reading on every connection
+        RejectAccepts,  // stop accepting new connections
+        CloseWorst,     // force-close the connections with the largest output buffers
+    };
+
+    using OverloadCallback = std::function<void(bool inOverloaded)>;
+
+    /**
+     * @brief Per-loop byte counter, padded to avoid false sharing between loops
+     */
+    struct alignas(64) Slot
+    {
+        EventLoop *loop{nullptr};
+        std::atomic<int64_t> bytes{0};
+    };
+
+    /**
+     * @brief Constructs a budget
+     * @param inLimitBytes Cap on bytes buffered across all connections
+     * @param inHighRatio Fraction of the cap at which the budget becomes overloaded
+     * @param inLowRatio Fraction of the cap at which an overloaded budget recovers
+     */
+    explicit OutputBudget(size_t inLimitBytes, double inHighRatio = 0.9, double inLowRatio = 0.75);
+
+    /**
+     * @brief Creates one counter per loop; must be called before any charge()
+     */
+    void registerLoops(const std::vector<EventLoop*> &inLoops);
+
+    /**
+     * @brief Gets the counter for a loop registered through registerLoops()
+     * @return The loop's slot, nullptr if the loop is unknown
+     */
+    Slot* slotFor(EventLoop *inLoop) const;
+
+    /**
+     * @brief Adds inDelta bytes (may be negative) to a loop's counter
+     * @details Called from the slot's loop thread; may invoke the overload callback
+     */
+    void charge(Slot *inSlot, int64_t inDelta);
+
+    /**
+     * @brief Thread-safe; a callback already running on an io thread may still finish after this returns
+     */
+    void setOverloadCallback(OverloadCallback inCb);
+
+    [[nodiscard]] size_t limit() const noexcept { return m_limit; }
+    [[nodiscard]] size_t highMark() const noexcept { return m_highMark; }
+    [[nodiscard]] size_t lowMark() const noexcept { return m_lowMark; }
+    [[nodiscard]] bool overloaded() const noexcept { return m_overloaded.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Sum of bytes currently buffered across all loops
+     */
+    [[nodiscard]] size_t bufferedBytes() const;
+
+private:
+    const size_t m_limit;
+    const size_t m_highMark;
+    const size_t m_lowMark;
+    std::vector<std::unique_ptr<Slot>> m_slots;  // fixed after registerLoops()
+    std::atomic<bool> m_overloaded{false};
+    std::shared_ptr<const OverloadCallback> m_overloadCallback;  // std::atomic_load/atomic_store only
+};
+
@@ -0,0 +1,165 @@
+#include "PerfCounters.h"
+#include "Logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+int perfEventOpen(uint32_t inType, uint64_t inConfig, int inGroup, bool inExcludeKernel)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = inType;
+    attr.config = inConfig;
+    attr.disabled = inGroup < 0 ? 1 : 0;  // the leader starts the group once complete
+    attr.exclude_kernel = inExcludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // This thread on any CPU
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, inGroup, PERF_FLAG_FD_CLOEXEC));
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters()
+{
+    if (!open(false) && !open(true))
+    {
+        LOG_ERROR("PerfCounters - perf_event_open failed: {}\n", strerror(errno));
+        return;
+    }
+    if (m_leader >= 0)
+    {
+        ::ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    m_last = read();
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open(bool inExcludeKernel)
+{
+    struct Event
+    {
+        Counter counter;
+        uint32_t type;
+        uint64_t config;
+    };
+    static const Event kEvents[] = {
+        {kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {kCacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {kContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+
+    for (const Event &event : kEvents)
+    {
+        if (inExcludeKernel && event.counter == kContextSwitches)
+        {
+            // Switches are counted in kernel context; taken from getrusage() instead
+            m_switchesFromRusage = true;
+            continue;
+        }
+        const int fd = perfEventOpen(event.type, event.config, m_leader, inExcludeKernel);
+        if (fd < 0)
+        {
+            if (!inExcludeKernel && (errno == EACCES || errno == EPERM))
+            {
+                // Not allowed to count the kernel; the caller retries with user space only
+                close();
+                return false;
+            }
+            continue;  // e.g. ENOENT: no such hardware event, typical in virtual machines
+        }
+        if (m_leader < 0)
+        {
+            m_leader = fd;
+        }
+        m_fds[event.counter] = fd;
+        m_slots[event.counter] = m_opened++;
+    }
+    m_countsKernel = !inExcludeKernel;
+    return valid();
+}
+
+void PerfCounters::close()
+{
+    for (int &fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    for (int &slot : m_slots)
+    {
+        slot = -1;
+    }
+    m_leader = -1;
+    m_opened = 0;
+}
+
+PerfCounts PerfCounters::read() const
+{
+    PerfCounts counts = m_last;
+    if (m_switchesFromRusage)
+    {
+        rusage usage;
+        if (::getrusage(RUSAGE_THREAD, &usage) == 0)
+        {
+            counts.contextSwitches = static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+        }
+    }
+    if (m_leader < 0)
+    {
+        return counts;
+    }
+    // nr, time_enabled, time_running, then one value per counter in open order
+    uint64_t data[3 + kCounters] = {};
+    if (::read(m_leader, data, sizeof(data)) < static_cast<ssize_t>((3 + m_opened) * sizeof(uint64_t)))
+    {
+        return counts;
+    }
+    const uint64_t enabled = data[1];
+    const uint64_t running = data[2];
+    auto value = [&](Counter inCounter) -> uint64_t {
+        const int slot = m_slots[inCounter];
+        if (slot < 0)
+        {
+            return 0;
+        }
+        const uint64_t raw = data[3 + slot];
+        // Scale up if the group only ran for part of the time it was enabled
+        return running > 0 && running < enabled
+            ? static_cast<uint64_t>(static_cast<double>(raw) * static_cast<double>(enabled) / static_cast<double>(running))
+            : raw;
+    };
+    counts.cycles = value(kCycles);
+    counts.instructions = value(kInstructions);
+    counts.cacheMisses = value(kCacheMisses);
+    if (!m_switchesFromRusage)
+    {
+        counts.contextSwitches = value(kContextSwitches);
+    }
+    return counts;
+}
+
+PerfCounts PerfCounters::lap()
+{
+    const PerfCounts now = read();
+    const PerfCounts delta = now - m_last;
+    m_last = now;
+    return delta;
+}
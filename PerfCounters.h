@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "LoopMetrics.h"
+
+/**
+ * @brief perf_event_open counters of the calling thread
+ *
+ * Opens one counter group: CPU cycles, instructions, last-level cache misses
+ * and context switches, read together with a single read(2). Kernel time is
+ * counted when kernel.perf_event_paranoid allows it (<= 1), otherwise only user
+ * space. A user-space-only context switch counter would always read 0, since
+ * switches happen in the kernel, so in that mode context switches come from
+ * getrusage(RUSAGE_THREAD) instead. Hardware counters are often missing in
+ * virtual machines; the hardware fields then stay 0. Multiplexed groups are
+ * scaled by their enabled/running time.
+ */
+class PerfCounters : noncopyable
+{
+public:
+    /**
+     * @brief Opens the counters for the calling thread; check valid()
+     */
+    PerfCounters();
+    ~PerfCounters();
+
+    [[nodiscard]] bool valid() const noexcept { return m_leader >= 0 || m_switchesFromRusage; }
+    [[nodiscard]] bool hasHardware() const noexcept { return m_slots[kCycles] >= 0; }
+    [[nodiscard]] bool countsKernel() const noexcept { return m_countsKernel; }
+
+    /**
+     * @brief Totals since the counters were opened
+     */
+    [[nodiscard]] PerfCounts read() const;
+
+    /**
+     * @brief Totals since the previous lap (or since opening)
+     */
+    PerfCounts lap();
+
+private:
+    enum Counter
+    {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kContextSwitches,
+        kCounters,
+    };
+
+    bool open(bool inExcludeKernel);
+    void close();
+
+    int m_leader{-1};
+    int m_fds[kCounters]{-1, -1, -1, -1};
+    int m_slots[kCounters]{-1, -1, -1, -1};  // position in the group read, -1 if not opened
+    int m_opened{0};
+    bool m_countsKernel{false};
+    bool m_switchesFromRusage{false};  // user-space-only mode
+    PerfCounts m_last;
+};
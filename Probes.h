@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * @brief USDT (user-level statically defined tracing) probes of the reactor
+ *
+ * Built with -DMUDUO_ENABLE_USDT=ON (needs <sys/sdt.h>, e.g. from
+ * systemtap-sdt-dev), every MUDUO_PROBE site becomes a single nop plus an ELF
+ * note that bpftrace, perf or SystemTap can attach to at runtime. Otherwise
+ * the macros expand to nothing and their arguments are not evaluated.
+ *
+ * All probes belong to the "muduo" provider; see tools/usdt for scripts.
+ *
+ *   poll__entry(loop, timeoutMs)        EventLoop::loop before Poller::poll
+ *   poll__exit(loop, events)            after Poller::poll, active channel count
+ *   channel__begin(fd, revents)         Channel::handleEvent entry
+ *   channel__end(fd, revents)           Channel::handleEvent exit
+ *   functors__begin(loop)               pending functor phase entry
+ *   functors__end(loop, ran)            pending functor phase exit, functors run
+ *   queue(loop, priority)               EventLoop::queueInLoop, any thread
+ *   wakeup(loop)                        EventLoop::wakeup, any thread
+ *   buffer__read(fd, bytes)             Buffer::readFd result, -1 on error
+ *   buffer__write(fd, bytes)            Buffer::writeFd result, -1 on error
+ *   conn__established(id, fd)           TcpConnection::connectEstablished
+ *   conn__destroyed(id, fd)             TcpConnection::connectDestroyed
+ *   conn__highwater(id, bytes)          output buffer crossed the high water mark
+ */
+
+#ifdef MUDUO_ENABLE_USDT
+
+#include <sys/sdt.h>
+
+#define MUDUO_PROBE1(name, a) DTRACE_PROBE1(muduo, name, a)
+#define MUDUO_PROBE2(name, a, b) DTRACE_PROBE2(muduo, name, a, b)
+
+#else
+
+#define MUDUO_PROBE1(name, a) do {} while (0)
+#define MUDUO_PROBE2(name, a, b) do {} while (0)
+
+#endif
@@ -6,7 +6,9 @@
 #include <sys/types.h>         
 #include <sys/socket.h>
 #include <strings.h>
+#include <cstring>
 #include <netinet/tcp.h>
+#include <errno.h>
 
 namespace
 {
@@ -17,6 +19,14 @@ void setSocketOption(int sockfd, int level, int option, bool value)
     int optval = value ? 1 : 0;
     ::setsockopt(sockfd, level, option, &optval, sizeof(optval));
 }
+
+void setIntSocketOption(int sockfd, int level, int option, int value, const char *name)
+{
+    if (::setsockopt(sockfd, level, option, &value, sizeof(value)) < 0)
+    {
+        LOG_ERROR("setsockopt {}={} on sockfd:{} failed, errno:{} \n", name, value, sockfd, errno);
+    }
+}
 }  // namespace
 
 Socket::~Socket()
@@ -30,7 +40,7 @@ void Socket::bindAddress(const InetAddress &inLocaladdr)
                reinterpret_cast<const sockaddr*>(inLocaladdr.getSockAddr()), 
                sizeof(sockaddr_in)) != 0)
     {
-        LOG_FATAL("bind sockfd:%d fail", m_sockfd);
+        LOG_FATAL("bind sockfd:{} fail", m_sockfd);
     }
 }
 
@@ -38,7 +48,7 @@ void Socket::listen()
 {
     if (::listen(m_sockfd, kMaxListenQueueSize) != 0)
     {
-        LOG_FATAL("listen sockfd:%d fail", m_sockfd);
+        LOG_FATAL("listen sockfd:{} fail", m_sockfd);
     }
 }
 
@@ -65,6 +75,13 @@ void Socket::shutdownWrite()
     }
 }
 
+bool Socket::getTcpInfo(tcp_info *outInfo) const
+{
+    socklen_t len = sizeof(*outInfo);
+    std::memset(outInfo, 0, len);
+    return ::getsockopt(m_sockfd, IPPROTO_TCP, TCP_INFO, outInfo, &len) == 0;
+}
+
 void Socket::setTcpNoDelay(bool inOn)
 {
     setSocketOption(m_sockfd, IPPROTO_TCP, TCP_NODELAY, inOn);
@@ -84,3 +101,98 @@ void Socket::setKeepAlive(bool inOn)
 {
     setSocketOption(m_sockfd, SOL_SOCKET, SO_KEEPALIVE, inOn);
 }
+
+void Socket::setTcpQuickAck(bool inOn)
+{
+    setSocketOption(m_sockfd, IPPROTO_TCP, TCP_QUICKACK, inOn);
+}
+
+void Socket::setTcpFastOpen(int inQueueLength)
+{
+    setIntSocketOption(m_sockfd, IPPROTO_TCP, TCP_FASTOPEN, inQueueLength, "TCP_FASTOPEN");
+}
+
+void Socket::setDeferAccept(int inSeconds)
+{
+    setIntSocketOption(m_sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, inSeconds, "TCP_DEFER_ACCEPT");
+}
+
+void Socket::setNotSentLowat(int inBytes)
+{
+    setIntSocketOption(m_sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, inBytes, "TCP_NOTSENT_LOWAT");
+}
+
+void Socket::setSendBufferSize(int inBytes)
+{
+    setIntSocketOption(m_sockfd, SOL_SOCKET, SO_SNDBUF, inBytes, "SO_SNDBUF");
+}
+
+void Socket::setReceiveBufferSize(int inBytes)
+{
+    setIntSocketOption(m_sockfd, SOL_SOCKET, SO_RCVBUF, inBytes, "SO_RCVBUF");
+}
+
+void Socket::applyListenOptions(const SocketOptions &inOptions)
+{
+    if (inOptions.fastOpenQueue > 0)
+    {
+        setTcpFastOpen(inOptions.fastOpenQueue);
+    }
+    if (inOptions.deferAcceptSeconds > 0)
+    {
+        setDeferAccept(inOptions.deferAcceptSeconds);
+    }
+    if (inOptions.receiveBufferBytes > 0)
+    {
+        setReceiveBufferSize(inOptions.receiveBufferBytes);
+    }
+}
+
+void Socket::applyConnectionOptions(const SocketOptions &inOptions)
+{
+    if (!inOptions.keepAlive)
+    {
+        setKeepAlive(false);  // TcpConnection enables it by default
+    }
+    if (inOptions.tcpNoDelay)
+    {
+        setTcpNoDelay(true);
+    }
+    if (inOptions.quickAck)
+    {
+        setTcpQuickAck(true);
+    }
+    if (inOptions.notSentLowat > 0)
+    {
+        setNotSentLowat(inOptions.notSentLowat);
+    }
+    if (inOptions.sendBufferBytes > 0)
+    {
+        setSendBufferSize(inOptions.sendBufferBytes);
+    }
+    if (inOptions.receiveBufferBytes > 0)
+    {
+        setReceiveBufferSize(inOptions.receiveBufferBytes);
+    }
+}
+
+SocketOptions SocketOptions::forProfile(SocketProfile inProfile)
+{
+    SocketOptions options;
+    switch (inProfile)
+    {
+    case SocketProfile::Latency:
+        options.fastOpenQueue = 256;
+        options.tcpNoDelay = true;
+        options.quickAck = true;
+        options.notSentLowat = 16 * 1024;  // keep queued-but-unsent data, and its delay, small
+        break;
+    case SocketProfile::Throughput:
+        options.sendBufferBytes = 4 * 1024 * 1024;
+        options.receiveBufferBytes = 4 * 1024 * 1024;
+        break;
+    case SocketProfile::Default:
+        break;
+    }
+    return options;
+}
@@ -3,6 +3,42 @@
 #include "noncopyable.h"
 
 class InetAddress;
+struct tcp_info;
+
+/**
+ * @brief Named sets of socket options applied by TcpServer
+ */
+enum class SocketProfile
+{
+    Default,     // keepalive only, kernel defaults otherwise
+    Latency,     // small request/response traffic: no Nagle, no delayed ACKs
+    Throughput,  // bulk transfers: large kernel buffers
+};
+
+/**
+ * @brief Socket options for a listening socket and the connections it accepts
+ * @details A value of 0 leaves the kernel default in place.
+ */
+struct SocketOptions
+{
+    // Listening socket
+    int fastOpenQueue{0};          ///< TCP_FASTOPEN: pending TFO requests, data arrives with the SYN
+    int deferAcceptSeconds{0};     ///< TCP_DEFER_ACCEPT: only accept once the client sent data;
+                                   ///< for protocols where the client speaks first
+
+    // Accepted sockets
+    bool keepAlive{true};          ///< SO_KEEPALIVE
+    bool tcpNoDelay{false};        ///< TCP_NODELAY: send small segments without waiting for ACKs
+    bool quickAck{false};          ///< TCP_QUICKACK, re-armed after each read event since the kernel clears it
+    int notSentLowat{0};           ///< TCP_NOTSENT_LOWAT: cap unsent bytes queued in the kernel
+    int sendBufferBytes{0};        ///< SO_SNDBUF, disables send buffer autotuning
+    int receiveBufferBytes{0};     ///< SO_RCVBUF, set on the listener too so the window scale fits
+
+    /**
+     * @brief Options for a named profile
+     */
+    static SocketOptions forProfile(SocketProfile inProfile);
+};
 
 /**
  * @brief RAII wrapper for socket file descriptor
@@ -56,6 +92,12 @@ public:
      */
     void shutdownWrite();
 
+    /**
+     * @brief Reads the kernel's TCP_INFO for this connection
+     * @return false if getsockopt failed
+     */
+    bool getTcpInfo(tcp_info *outInfo) const;
+
     /**
      * @brief Sets TCP_NODELAY option (disables Nagle's algorithm)
      * @param inOn True to enable the option, false to disable
@@ -80,6 +122,51 @@ public:
      */
     void setKeepAlive(bool inOn);
 
+    /**
+     * @brief Sets TCP_QUICKACK option (acknowledge immediately instead of delaying ACKs)
+     * @param inOn True to enable the option, false to disable
+     * @note The kernel may clear this after any receive; set it again after reads
+     */
+    void setTcpQuickAck(bool inOn);
+
+    /**
+     * @brief Sets TCP_FASTOPEN on a listening socket
+     * @param inQueueLength Maximum number of pending fast open requests, 0 disables
+     */
+    void setTcpFastOpen(int inQueueLength);
+
+    /**
+     * @brief Sets TCP_DEFER_ACCEPT on a listening socket
+     * @param inSeconds How long to wait for the first data before accepting anyway
+     */
+    void setDeferAccept(int inSeconds);
+
+    /**
+     * @brief Sets TCP_NOTSENT_LOWAT option
+     * @param inBytes Unsent bytes above which the socket stops being writable
+     */
+    void setNotSentLowat(int inBytes);
+
+    /**
+     * @brief Sets SO_SNDBUF option
+     */
+    void setSendBufferSize(int inBytes);
+
+    /**
+     * @brief Sets SO_RCVBUF option
+     */
+    void setReceiveBufferSize(int inBytes);
+
+    /**
+     * @brief Applies the listening socket part of inOptions; call before listen()
+     */
+    void applyListenOptions(const SocketOptions &inOptions);
+
+    /**
+     * @brief Applies the per-connection part of inOptions to an accepted socket
+     */
+    void applyConnectionOptions(const SocketOptions &inOptions);
+
 private:
     const int m_sockfd;  ///< The underlying socket file descriptor
 };
\ No newline at end of file
@@ -1,8 +1,7 @@
 #include "TcpConnection.h"
 #include "Logger.h"
-#include "Socket.h"
-#include "Channel.h"
 #include "EventLoop.h"
+#include "Probes.h"
 
 #include <functional>
 #include <errno.h>
@@ -11,6 +10,7 @@
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <string_view>
+#include <algorithm>
 
 namespace {
     constexpr size_t kDefaultHighWaterMark = 64 * 1024 * 1024;  // 64MB
@@ -19,7 +19,7 @@ namespace {
     {
         if (inLoop == nullptr)
         {
-            LOG_FATAL("%s:%s:%d TcpConnection Loop is null!\n", __FILE__, __func__, __LINE__);
+            LOG_FATAL("{}:{}:{} TcpConnection Loop is null!\n", __FILE__, __func__, __LINE__);
         }
         return inLoop;
     }
@@ -30,32 +30,122 @@ TcpConnection::TcpConnection(EventLoop *inLoop,
                            int inSockfd,
                            InetAddress inLocalAddr,
                            InetAddress inPeerAddr)
+    : TcpConnection(inLoop, 0, nullptr, inSockfd, std::move(inPeerAddr))
+{
+    std::call_once(m_nameOnce, [&]() { m_name = std::move(inName); });
+    std::call_once(m_localAddrOnce, [&]() { m_localAddr = std::move(inLocalAddr); });
+}
+
+TcpConnection::TcpConnection(EventLoop *inLoop,
+                           uint64_t inId,
+                           std::shared_ptr<const std::string> inNamePrefix,
+                           int inSockfd,
+                           InetAddress inPeerAddr)
     : m_loop(CheckLoopNotNull(inLoop))
-    , m_name(std::move(inName))
+    , m_id(inId)
     , m_state(State::Connecting)
-    , m_reading(true)
-    , m_socket(std::make_unique<Socket>(inSockfd))
-    , m_channel(std::make_unique<Channel>(inLoop, inSockfd))
-    , m_localAddr(std::move(inLocalAddr))
+    , m_reading(false)
+    , m_socket(inSockfd)
+    , m_channel(inLoop, inSockfd)
+    , m_namePrefix(std::move(inNamePrefix))
     , m_peerAddr(std::move(inPeerAddr))
     , m_highWaterMark(kDefaultHighWaterMark)
 {
     // Set callback functions for the channel
-    m_channel->setReadCallback(
+    m_channel.setReadCallback(
         [this](Timestamp t) { handleRead(t); }
     );
-    m_channel->setWriteCallback(
+    m_channel.setWriteCallback(
         [this]() { handleWrite(); }
     );
-    m_channel->setCloseCallback(
+    m_channel.setCloseCallback(
         [this]() { handleClose(); }
     );
-    m_channel->setErrorCallback(
+    m_channel.setErrorCallback(
         [this]() { handleError(); }
     );
+    m_channel.setOwnerId(inId);
 
-    LOG_INFO("TcpConnection::ctor[{}] at fd={}\n", m_name, inSockfd); // ctor = constructor
-    m_socket->setKeepAlive(true);
+    LOG_INFO("TcpConnection::ctor[#{}] at fd={}\n", inId, inSockfd); // ctor = constructor
+    m_socket.setKeepAlive(true);
+}
+
+TcpConnection& TcpConnection::setSocketOptions(const SocketOptions &inOptions)
+{
+    m_socket.applyConnectionOptions(inOptions);
+    m_quickAck = inOptions.quickAck;
+    return *this;
+}
+
+const std::string& TcpConnection::getName() const
+{
+    std::call_once(m_nameOnce, [this]() {
+        m_name = (m_namePrefix ? *m_namePrefix : std::string()) + std::to_string(m_id);
+    });
+    return m_name;
+}
+
+const InetAddress& TcpConnection::getLocalAddress() const
+{
+    std::call_once(m_localAddrOnce, [this]() {
+        sockaddr_in local{};
+        socklen_t addrlen = sizeof(local);
+        if (::getsockname(m_socket.fd(), reinterpret_cast<sockaddr*>(&local), &addrlen) < 0)
+        {
+            LOG_ERROR("TcpConnection::getLocalAddress");
+        }
+        m_localAddr = InetAddress(local);
+    });
+    return m_localAddr;
+}
+
+void TcpConnection::Stats::accumulate(const Stats &inOther) noexcept
+{
+    bytesRead += inOther.bytesRead;
+    bytesWritten += inOther.bytesWritten;
+    readCalls += inOther.readCalls;
+    writeCalls += inOther.writeCalls;
+    messageCallbacks += inOther.messageCallbacks;
+    messageCallbackNs += inOther.messageCallbackNs;
+    maxMessageCallbackNs = std::max(maxMessageCallbackNs, inOther.maxMessageCallbackNs);
+    peakOutputBytes = std::max(peakOutputBytes, inOther.peakOutputBytes);
+    highWaterMarkCrossings += inOther.highWaterMarkCrossings;
+    overHighWaterMarkNs += inOther.overHighWaterMarkNs;
+}
+
+TcpConnection::Stats TcpConnection::stats() const
+{
+    Stats stats = m_stats;
+    if (m_overHighWaterMark)
+    {
+        stats.overHighWaterMarkNs += monotonicNanos() - m_overHighWaterMarkSince;
+    }
+    return stats;
+}
+
+bool TcpConnection::sampleTcpInfo()
+{
+    tcp_info info;
+    if (!m_socket.getTcpInfo(&info))
+    {
+        return false;
+    }
+    m_stats.tcpInfoTime = Timestamp::now();
+    m_stats.rttUs = info.tcpi_rtt;
+    m_stats.rttVarUs = info.tcpi_rttvar;
+    m_stats.sendCongestionWindow = info.tcpi_snd_cwnd;
+    m_stats.retransmits = info.tcpi_total_retrans;
+    return true;
+}
+
+void TcpConnection::stopTcpInfoSampling()
+{
+    if (m_tcpInfoTimer.valid())
+    {
+        m_loop->cancel(m_tcpInfoTimer);
+        m_tcpInfoTimer = TimerId();
+        sampleTcpInfo();
+    }
 }
 
 void TcpConnection::send(std::string_view inMsg)
@@ -88,17 +178,33 @@ void TcpConnection::sendInLoop(const void* inData, size_t inLen)
         return;
     }
 
+    // With auto-cork or write scheduling the data is only buffered; the loop writes it
+    // after this iteration
+    if (m_autoCork || m_loop->writeScheduler() != nullptr)
+    {
+        size_t oldLen = m_outputBuffer.readableBytes();
+        checkHighWaterMark(oldLen, oldLen + inLen);
+        m_outputBuffer.append(static_cast<const char*>(inData), inLen);
+        syncOutputBudget();
+        scheduleFlush();
+        return;
+    }
+
     // First write attempt if the channel is not writing and output buffer is empty
-    if (!m_channel->isWriting() && m_outputBuffer.readableBytes() == 0)
+    const size_t allowance = m_writeThrottled ? 0 : m_writeLimiter.available();
+    if (!m_channel.isWriting() && m_outputBuffer.readableBytes() == 0 && allowance > 0)
     {
-        nwrote = ::write(m_channel->getFd(), inData, inLen);
+        nwrote = ::write(m_channel.getFd(), inData, std::min(inLen, allowance));
+        ++m_stats.writeCalls;
         if (nwrote >= 0)
         {
+            m_stats.bytesWritten += nwrote;
+            m_writeLimiter.consume(nwrote);
             remaining = inLen - nwrote;
             if (remaining == 0 && m_writeCompleteCallback)
             {
-                m_loop->queueInLoop([this, self = shared_from_this()]() {
-                    m_writeCompleteCallback(self);
+                m_loop->queueInLoop([this, ref = ConnectionRef(this)]() {
+                    m_writeCompleteCallback(m_self);
                 });
             }
         }
@@ -120,20 +226,459 @@ void TcpConnection::sendInLoop(const void* inData, size_t inLen)
     if (!faultError && remaining > 0)
     {
         size_t oldLen = m_outputBuffer.readableBytes();
-        if (oldLen + remaining >= m_highWaterMark
-            && oldLen < m_highWaterMark
-            && m_highWaterMarkCallback)
+        checkHighWaterMark(oldLen, oldLen + remaining);
+        m_outputBuffer.append(static_cast<const char*>(inData) + nwrote, remaining);
+        syncOutputBudget();
+        armWriting();
+    }
+}
+
+char* TcpConnection::reserveSend(size_t inLen)
+{
+    return m_outputBuffer.reserve(inLen);
+}
+
+void TcpConnection::commitSend(size_t inLen)
+{
+    if (m_state == State::Disconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    m_outputBuffer.hasWritten(inLen);
+    // Compare against the size last synced, not newLen - inLen: bytes placed by earlier
+    // reserveSend() commits or through outputBuffer() are new to the check as well
+    checkHighWaterMark(m_bufferedOutputBytes.load(std::memory_order_relaxed), m_outputBuffer.readableBytes());
+    syncOutputBudget();
+    scheduleFlush();
+}
+
+void TcpConnection::scheduleFlush()
+{
+    if (WriteScheduler *scheduler = m_loop->writeScheduler())
+    {
+        if (!m_channel.isWriting() && !m_writeThrottled)
         {
-            m_loop->queueInLoop([this, self = shared_from_this(), len = oldLen + remaining]() {
-                m_highWaterMarkCallback(self, len);
+            scheduler->enqueue(ConnectionRef(this));
+        }
+        return;
+    }
+
+    // An armed EPOLLOUT already drains the buffer; otherwise coalesce all output
+    // of this iteration into a single write attempt
+    if (!m_flushPending && !m_channel.isWriting() && !m_writeThrottled)
+    {
+        m_flushPending = true;
+        m_loop->queueFlush([ref = ConnectionRef(this)]() {
+            ref->flushOutputInLoop();
+        });
+    }
+}
+
+void TcpConnection::flushOutputInLoop()
+{
+    m_flushPending = false;
+    if (m_state == State::Disconnected || m_channel.isWriting() || m_writeThrottled
+        || m_outputBuffer.readableBytes() == 0)
+    {
+        return;
+    }
+
+    const size_t allowance = m_writeLimiter.available();
+    if (allowance == 0)
+    {
+        throttleWrite();
+        return;
+    }
+
+    int savedErrno = 0;
+    ssize_t n = m_outputBuffer.writeFd(m_channel.getFd(), &savedErrno, allowance);
+    ++m_stats.writeCalls;
+    if (n > 0)
+    {
+        m_stats.bytesWritten += n;
+        m_writeLimiter.consume(n);
+        m_outputBuffer.retrieve(n);
+        syncOutputBudget();
+        checkLowWaterMark();
+    }
+    else if (savedErrno != EWOULDBLOCK)
+    {
+        LOG_ERROR("TcpConnection::flushOutputInLoop name:{} errno:{}\n", getName(), savedErrno);
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            handleClose();
+            return;
+        }
+    }
+
+    if (m_outputBuffer.readableBytes() == 0)
+    {
+        if (m_writeCompleteCallback)
+        {
+            m_loop->queueInLoop([this, ref = ConnectionRef(this)]() {
+                m_writeCompleteCallback(m_self);
             });
         }
-        m_outputBuffer.append(static_cast<const char*>(inData) + nwrote, remaining);
-        if (!m_channel->isWriting())
+        if (m_state == State::Disconnecting)
         {
-            m_channel->enableWriting();
+            shutdownInLoop();
         }
     }
+    else
+    {
+        armWriting();
+    }
+}
+
+void TcpConnection::armWriting()
+{
+    if (m_channel.isWriting() || m_writeThrottled)
+    {
+        return;
+    }
+    if (m_writeLimiter.available() == 0)
+    {
+        throttleWrite();
+    }
+    else if (WriteScheduler *scheduler = m_loop->writeScheduler())
+    {
+        scheduler->enqueue(ConnectionRef(this));
+    }
+    else
+    {
+        m_channel.enableWriting();
+    }
+}
+
+WriteScheduler::WriteResult TcpConnection::writeScheduled(size_t inMaxBytes, size_t *outWritten)
+{
+    *outWritten = 0;
+    if (m_state == State::Disconnected || m_writeThrottled || m_outputBuffer.readableBytes() == 0)
+    {
+        return WriteScheduler::WriteResult::Done;
+    }
+
+    const size_t allowance = std::min(inMaxBytes, m_writeLimiter.available());
+    if (allowance == 0)
+    {
+        throttleWrite();
+        return WriteScheduler::WriteResult::Done;
+    }
+
+    int savedErrno = 0;
+    ssize_t n = m_outputBuffer.writeFd(m_channel.getFd(), &savedErrno, allowance);
+    ++m_stats.writeCalls;
+    if (n < 0)
+    {
+        if (savedErrno == EWOULDBLOCK)
+        {
+            m_channel.enableWriting();
+            return WriteScheduler::WriteResult::Blocked;
+        }
+        LOG_ERROR("TcpConnection::writeScheduled name:{} errno:{}\n", getName(), savedErrno);
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            // The peer is gone; tear down now instead of waiting on a socket that will never drain
+            handleClose();
+        }
+        return WriteScheduler::WriteResult::Done;
+    }
+
+    *outWritten = static_cast<size_t>(n);
+    m_stats.bytesWritten += n;
+    m_writeLimiter.consume(n);
+    m_outputBuffer.retrieve(n);
+    syncOutputBudget();
+    checkLowWaterMark();
+
+    if (m_outputBuffer.readableBytes() == 0)
+    {
+        if (m_writeCompleteCallback)
+        {
+            m_loop->queueInLoop([this, ref = ConnectionRef(this)]() {
+                m_writeCompleteCallback(m_self);
+            });
+        }
+        if (m_state == State::Disconnecting)
+        {
+            shutdownInLoop();
+        }
+        return WriteScheduler::WriteResult::Done;
+    }
+
+    // A short write means the socket buffer is full; wait for EPOLLOUT
+    if (static_cast<size_t>(n) < allowance)
+    {
+        m_channel.enableWriting();
+        return WriteScheduler::WriteResult::Blocked;
+    }
+    return WriteScheduler::WriteResult::Pending;
+}
+
+void TcpConnection::throttleWrite()
+{
+    if (m_writeThrottled)
+    {
+        return;
+    }
+    m_writeThrottled = true;
+    if (m_channel.isWriting())
+    {
+        m_channel.disableWriting();
+    }
+    m_loop->runAfter(m_writeLimiter.secondsUntilAvailable(), [this, ref = ConnectionRef(this)]() {
+        m_writeThrottled = false;
+        if ((m_state == State::Connected || m_state == State::Disconnecting)
+            && m_outputBuffer.readableBytes() > 0)
+        {
+            armWriting();
+        }
+    });
+}
+
+void TcpConnection::throttleRead()
+{
+    if (m_readThrottled)
+    {
+        return;
+    }
+    m_readThrottled = true;
+    setReadPausedInLoop(kPauseByRateLimit, true);
+
+    double delay = m_readLimiter.secondsUntilAvailable();
+    delay = std::max(delay, m_messageLimiter.secondsUntilAvailable());
+    if (m_readGroupLimiter)
+    {
+        delay = std::max(delay, m_readGroupLimiter->secondsUntilAvailable());
+    }
+    m_loop->runAfter(delay, [this, ref = ConnectionRef(this)]() {
+        m_readThrottled = false;
+        setReadPausedInLoop(kPauseByRateLimit, false);
+    });
+}
+
+size_t TcpConnection::readAllowance()
+{
+    if (m_messageLimiter.available() == 0)
+    {
+        return 0;
+    }
+    size_t allowance = m_readLimiter.available();
+    if (m_readGroupLimiter)
+    {
+        allowance = std::min(allowance, m_readGroupLimiter->available());
+    }
+    return allowance;
+}
+
+TcpConnection& TcpConnection::setReadRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept
+{
+    m_readLimiter.configure(inBytesPerSecond, inBurstBytes);
+    return *this;
+}
+
+TcpConnection& TcpConnection::setWriteRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept
+{
+    m_writeLimiter.configure(inBytesPerSecond, inBurstBytes);
+    return *this;
+}
+
+TcpConnection& TcpConnection::setMessageRateLimit(double inMessagesPerSecond, double inBurst) noexcept
+{
+    m_messageLimiter.configure(inMessagesPerSecond, inBurst);
+    return *this;
+}
+
+TcpConnection& TcpConnection::setReadRateGroup(std::shared_ptr<SharedTokenBucket> inGroup) noexcept
+{
+    m_readGroupLimiter = std::move(inGroup);
+    return *this;
+}
+
+void TcpConnection::checkHighWaterMark(size_t inOldLen, size_t inNewLen)
+{
+    m_stats.peakOutputBytes = std::max(m_stats.peakOutputBytes, inNewLen);
+    if (inNewLen >= m_highWaterMark
+        && inOldLen < m_highWaterMark
+        && m_highWaterMarkCallback)
+    {
+        m_loop->queueInLoop([this, ref = ConnectionRef(this), len = inNewLen]() {
+            m_highWaterMarkCallback(m_self, len);
+        });
+    }
+
+    if (inNewLen >= m_highWaterMark && !m_overHighWaterMark)
+    {
+        m_overHighWaterMark = true;
+        m_overHighWaterMarkSince = monotonicNanos();
+        ++m_stats.highWaterMarkCrossings;
+        MUDUO_PROBE2(conn__highwater, m_id, inNewLen);
+        if (auto peer = m_backpressurePeer.lock())
+        {
+            peer->notePeerCongestion(true);
+        }
+    }
+}
+
+void TcpConnection::checkLowWaterMark()
+{
+    const size_t len = m_outputBuffer.readableBytes();
+    if (!m_overHighWaterMark || len > m_lowWaterMark)
+    {
+        return;
+    }
+
+    releaseBackpressure();
+    if (m_lowWaterMarkCallback)
+    {
+        m_loop->queueInLoop([this, ref = ConnectionRef(this), len]() {
+            m_lowWaterMarkCallback(m_self, len);
+        });
+    }
+}
+
+void TcpConnection::releaseBackpressure()
+{
+    if (!m_overHighWaterMark)
+    {
+        return;
+    }
+    m_overHighWaterMark = false;
+    m_stats.overHighWaterMarkNs += monotonicNanos() - m_overHighWaterMarkSince;
+    if (auto peer = m_backpressurePeer.lock())
+    {
+        peer->notePeerCongestion(false);
+    }
+}
+
+TcpConnection& TcpConnection::setBackpressurePeer(const TcpConnectionPtr &inPeer)
+{
+    // While congested, the pause moves with the link instead of staying on the old peer
+    if (m_overHighWaterMark)
+    {
+        if (auto peer = m_backpressurePeer.lock())
+        {
+            peer->notePeerCongestion(false);
+        }
+        if (inPeer)
+        {
+            inPeer->notePeerCongestion(true);
+        }
+    }
+    m_backpressurePeer = inPeer;
+    return *this;
+}
+
+void TcpConnection::syncOutputBudget()
+{
+    // A closed connection no longer counts, even though its buffer lives until destruction
+    const size_t current = (m_state == State::Disconnected) ? 0 : m_outputBuffer.readableBytes();
+    const size_t charged = m_bufferedOutputBytes.exchange(current, std::memory_order_relaxed);
+    if (m_budgetSlot != nullptr && current != charged)
+    {
+        m_outputBudget->charge(m_budgetSlot,
+                               static_cast<int64_t>(current) - static_cast<int64_t>(charged));
+    }
+}
+
+TcpConnection& TcpConnection::setOutputBudget(std::shared_ptr<OutputBudget> inBudget) noexcept
+{
+    m_outputBudget = std::move(inBudget);
+    m_budgetSlot = m_outputBudget ? m_outputBudget->slotFor(m_loop) : nullptr;
+    return *this;
+}
+
+void TcpConnection::setOverloadPaused(bool inPaused)
+{
+    setReadPaused(kPauseByOverload, inPaused);
+}
+
+void TcpConnection::forceClose()
+{
+    if (m_state == State::Connected || m_state == State::Disconnecting)
+    {
+        setState(State::Disconnecting);
+        m_loop->queueInLoop([self = shared_from_this()]() {
+            self->forceCloseInLoop();
+        });
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (m_state == State::Connected || m_state == State::Disconnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::startRead()
+{
+    setReadPaused(kPauseByUser, false);
+}
+
+void TcpConnection::stopRead()
+{
+    setReadPaused(kPauseByUser, true);
+}
+
+void TcpConnection::setReadPaused(ReadPauseReason inReason, bool inPaused)
+{
+    m_loop->runInLoop([self = shared_from_this(), inReason, inPaused]() {
+        self->setReadPausedInLoop(inReason, inPaused);
+    });
+}
+
+void TcpConnection::setReadPausedInLoop(ReadPauseReason inReason, bool inPaused)
+{
+    if (inPaused)
+    {
+        m_readPauseReasons |= inReason;
+    }
+    else
+    {
+        m_readPauseReasons &= ~inReason;
+    }
+
+    // Channel interest is only managed while the connection is live
+    if (m_state != State::Connected && m_state != State::Disconnecting)
+    {
+        return;
+    }
+
+    const bool shouldRead = (m_readPauseReasons == 0);
+    if (shouldRead && !m_channel.isReading())
+    {
+        m_channel.enableReading();
+        m_reading = true;
+    }
+    else if (!shouldRead && m_channel.isReading())
+    {
+        m_channel.disableReading();
+        m_reading = false;
+    }
+}
+
+void TcpConnection::notePeerCongestion(bool inCongested)
+{
+    m_loop->runInLoop([self = shared_from_this(), inCongested]() {
+        self->notePeerCongestionInLoop(inCongested);
+    });
+}
+
+void TcpConnection::notePeerCongestionInLoop(bool inCongested)
+{
+    if (inCongested)
+    {
+        ++m_congestedPeers;
+    }
+    else if (m_congestedPeers > 0)
+    {
+        --m_congestedPeers;
+    }
+    setReadPausedInLoop(kPauseByPeer, m_congestedPeers > 0);
 }
 
 void TcpConnection::shutdown()
@@ -147,21 +692,37 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!m_channel->isWriting())
+    // Data committed but not yet flushed is shut down by flushOutputInLoop/handleWrite
+    if (!m_channel.isWriting() && m_outputBuffer.readableBytes() == 0)
     {
-        m_socket->shutdownWrite();
+        m_socket.shutdownWrite();
     }
 }
 
 void TcpConnection::connectEstablished()
 {
     setState(State::Connected);
-    m_channel->tie(shared_from_this());
-    m_channel->enableReading();
+    MUDUO_PROBE2(conn__established, m_id, m_channel.getFd());
+    // Alive until connectDestroyed(), which runs as a functor, never inside event dispatch
+    m_self = shared_from_this();
+    if (m_readPauseReasons == 0)
+    {
+        m_channel.enableReading();
+        m_reading = true;
+    }
+    if (m_tcpInfoInterval > 0)
+    {
+        m_tcpInfoTimer = m_loop->runEvery(m_tcpInfoInterval, [weak = weak_from_this()]() {
+            if (auto self = weak.lock())
+            {
+                self->sampleTcpInfo();
+            }
+        });
+    }
 
     if (m_connectionCallback)
     {
-        m_connectionCallback(shared_from_this());
+        m_connectionCallback(m_self);
     }
 }
 
@@ -170,56 +731,174 @@ void TcpConnection::connectDestroyed()
     if (m_state == State::Connected)
     {
         setState(State::Disconnected);
-        m_channel->disableAll();
+        m_channel.disableAll();
+        m_reading = false;
+        syncOutputBudget();
+        stopTcpInfoSampling();
+        releaseBackpressure();
         if (m_connectionCallback)
         {
             m_connectionCallback(shared_from_this());
         }
     }
-    m_channel->remove();
+    MUDUO_PROBE2(conn__destroyed, m_id, m_channel.getFd());
+    m_channel.remove();
+    // The caller holds a reference, so this does not destroy the connection yet
+    m_destroyed = true;
+    if (m_loopRefs == 0)
+    {
+        releaseSelf();
+    }
+}
+
+void TcpConnection::releaseSelf()
+{
+    TcpConnectionPtr self;
+    self.swap(m_self);
 }
 
 void TcpConnection::handleRead(Timestamp inReceiveTime)
 {
-    int savedErrno = 0;
-    ssize_t n = m_inputBuffer.readFd(m_channel->getFd(), &savedErrno);
-    
-    if (n > 0)
+    const size_t bytesRead = readInput(inReceiveTime);
+    // The kernel leaves quick ACK mode on its own; re-arm once per readiness event
+    if (m_quickAck && bytesRead > 0 && m_state == State::Connected)
     {
-        if (m_messageCallback)
-        {
-            m_messageCallback(shared_from_this(), &m_inputBuffer, inReceiveTime);
-        }
+        m_socket.setTcpQuickAck(true);
     }
-    else if (n == 0)
+}
+
+size_t TcpConnection::readInput(Timestamp inReceiveTime)
+{
+    // Per-iteration fairness budgets; 0 bytes means unlimited
+    const size_t byteBudget = m_readBytesBudget > 0 ? m_readBytesBudget : m_loop->readBytesBudget();
+    const size_t messageBudget = std::max<size_t>(
+        m_readMessagesBudget > 0 ? m_readMessagesBudget : m_loop->readMessagesBudget(), 1);
+    size_t bytesRead = 0;
+    bool filled = false;    // the last read got all it asked for, so input may be left
+
+    for (size_t messages = 0; messages < messageBudget; ++messages)
     {
-        handleClose();
+        // Out of tokens: pause reading and let a loop timer resume it
+        size_t allowance = readAllowance();
+        if (allowance == 0)
+        {
+            throttleRead();
+            return bytesRead;
+        }
+        if (byteBudget > 0)
+        {
+            allowance = std::min(allowance, byteBudget - bytesRead);
+        }
+
+        int savedErrno = 0;
+        const size_t capacity = m_inputBuffer.readFdCapacity(allowance);
+        ssize_t n = m_inputBuffer.readFd(m_channel.getFd(), &savedErrno, allowance);
+        ++m_stats.readCalls;
+
+        if (n > 0)
+        {
+            m_stats.bytesRead += n;
+            m_readLimiter.consume(n);
+            m_messageLimiter.consume(1);
+            if (m_readGroupLimiter)
+            {
+                m_readGroupLimiter->consume(n);
+            }
+            bytesRead += n;
+            filled = static_cast<size_t>(n) == capacity;
+            if (m_messageCallback)
+            {
+                const int64_t start = monotonicNanos();
+                m_messageCallback(m_self, &m_inputBuffer, inReceiveTime);
+                const int64_t elapsed = monotonicNanos() - start;
+                ++m_stats.messageCallbacks;
+                m_stats.messageCallbackNs += elapsed;
+                m_stats.maxMessageCallbackNs = std::max(m_stats.maxMessageCallbackNs, elapsed);
+            }
+
+            // The callback may have closed the connection or paused reading
+            if (m_state != State::Connected || !m_channel.isReading())
+            {
+                return bytesRead;
+            }
+            if (byteBudget > 0 && bytesRead >= byteBudget)
+            {
+                // A read cut short by the budget leaves input behind; serve it next iteration
+                if (filled)
+                {
+                    m_loop->queueReadyChannel(&m_channel);
+                }
+                return bytesRead;
+            }
+        }
+        else if (n == 0)
+        {
+            handleClose();
+            return bytesRead;
+        }
+        else
+        {
+            // Expected once the socket is drained, or for a channel re-queued as ready
+            if (savedErrno == EWOULDBLOCK)
+            {
+                return bytesRead;
+            }
+            errno = savedErrno;
+            LOG_ERROR("TcpConnection::readInput");
+            handleError();
+            return bytesRead;
+        }
     }
-    else
+
+    // The message budget ran out and the last read suggests the socket is not drained
+    if (messageBudget > 1 && filled)
     {
-        errno = savedErrno;
-        LOG_ERROR("TcpConnection::handleRead");
-        handleError();
+        m_loop->queueReadyChannel(&m_channel);
     }
+    return bytesRead;
 }
 
 void TcpConnection::handleWrite()
 {
-    if (m_channel->isWriting())
+    // With a write scheduler EPOLLOUT only signals that the socket drained;
+    // the scheduler decides when and how much to write
+    if (WriteScheduler *scheduler = m_loop->writeScheduler())
+    {
+        if (m_channel.isWriting())
+        {
+            m_channel.disableWriting();
+            scheduler->enqueue(ConnectionRef(this));
+        }
+        return;
+    }
+
+    if (m_channel.isWriting())
     {
+        const size_t allowance = m_writeLimiter.available();
+        if (allowance == 0)
+        {
+            throttleWrite();
+            return;
+        }
+
         int savedErrno = 0;
-        ssize_t n = m_outputBuffer.writeFd(m_channel->getFd(), &savedErrno);
-        
+        ssize_t n = m_outputBuffer.writeFd(m_channel.getFd(), &savedErrno, allowance);
+        ++m_stats.writeCalls;
+
         if (n > 0)
         {
+            m_stats.bytesWritten += n;
+            m_writeLimiter.consume(n);
             m_outputBuffer.retrieve(n);
+            syncOutputBudget();
+            checkLowWaterMark();
             if (m_outputBuffer.readableBytes() == 0)
             {
-                m_channel->disableWriting();
+                m_channel.disableWriting();
                 if (m_writeCompleteCallback)
                 {
-                    m_loop->queueInLoop([this, self = shared_from_this()]() {
-                        m_writeCompleteCallback(self);
+                    m_loop->queueInLoop([this, ref = ConnectionRef(this)]() {
+                        m_writeCompleteCallback(m_self);
                     });
                 }
                 if (m_state == State::Disconnecting)
@@ -235,15 +914,21 @@ void TcpConnection::handleWrite()
     }
     else
     {
-        LOG_ERROR("TcpConnection fd={} is down, no more writing\n", m_channel->getFd());
+        LOG_ERROR("TcpConnection fd={} is down, no more writing\n", m_channel.getFd());
     }
 }
 
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd={} state={}\n", m_channel->getFd(), static_cast<int>(m_state.load()));
+    LOG_INFO("TcpConnection::handleClose fd={} state={}\n", m_channel.getFd(), static_cast<int>(m_state.load()));
     setState(State::Disconnected);
-    m_channel->disableAll();
+    m_channel.disableAll();
+    m_reading = false;
+    syncOutputBudget();
+    stopTcpInfoSampling();
+
+    // Never leave a linked producer paused on behalf of a connection that is gone
+    releaseBackpressure();
 
     TcpConnectionPtr connPtr(shared_from_this());
     if (m_connectionCallback)
@@ -262,7 +947,7 @@ void TcpConnection::handleError()
     socklen_t optlen = sizeof(optval);
     int err = 0;
     
-    if (::getsockopt(m_channel->getFd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if (::getsockopt(m_channel.getFd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -270,5 +955,5 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:{} - SO_ERROR:{}\n", m_name, err);
+    LOG_ERROR("TcpConnection::handleError name:{} - SO_ERROR:{}\n", getName(), err);
 }
\ No newline at end of file
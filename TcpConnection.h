@@ -3,16 +3,22 @@
 #include "noncopyable.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
+#include "ConnectionRef.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "OutputBudget.h"
+#include "TokenBucket.h"
+#include "WriteScheduler.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "TimerQueue.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <mutex>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * @brief TCP connection class that handles individual connections
@@ -36,15 +42,87 @@ public:
                   int inSockfd,
                   InetAddress inLocalAddr,
                   InetAddress inPeerAddr);
+
+    /**
+     * @brief Constructs a TCP connection whose name and local address are resolved lazily
+     * @param inLoop Event loop that manages this connection
+     * @param inId Numeric connection identifier, unique per server
+     * @param inNamePrefix Shared name prefix; the name is the prefix followed by inId
+     * @param inSockfd Socket file descriptor
+     * @param inPeerAddr Peer address
+     */
+    TcpConnection(EventLoop *inLoop,
+                  uint64_t inId,
+                  std::shared_ptr<const std::string> inNamePrefix,
+                  int inSockfd,
+                  InetAddress inPeerAddr);
     
     ~TcpConnection() = default;
 
     // Getters
     [[nodiscard]] EventLoop* getLoop() const noexcept { return m_loop; }
-    [[nodiscard]] const std::string& getName() const noexcept { return m_name; }
-    [[nodiscard]] const InetAddress& getLocalAddress() const noexcept { return m_localAddr; }
+    [[nodiscard]] uint64_t getId() const noexcept { return m_id; }
+    [[nodiscard]] const std::string& getName() const;
+    [[nodiscard]] const InetAddress& getLocalAddress() const;
     [[nodiscard]] const InetAddress& getPeerAddress() const noexcept { return m_peerAddr; }
     [[nodiscard]] bool isConnected() const noexcept { return m_state == State::Connected; }
+    [[nodiscard]] bool isReading() const noexcept { return m_reading; }
+
+    /**
+     * @brief Traffic and latency counters, maintained inline by the loop thread
+     */
+    struct Stats
+    {
+        uint64_t bytesRead{0};
+        uint64_t bytesWritten{0};
+        uint64_t readCalls{0};              ///< read syscalls, including ones that found no data
+        uint64_t writeCalls{0};             ///< write syscalls
+        uint64_t messageCallbacks{0};
+        int64_t messageCallbackNs{0};       ///< total time spent in the MessageCallback
+        int64_t maxMessageCallbackNs{0};
+        size_t peakOutputBytes{0};          ///< largest output buffer seen
+        uint64_t highWaterMarkCrossings{0};
+        int64_t overHighWaterMarkNs{0};     ///< time from reaching the high water mark until
+                                            ///< draining to the low water mark, ongoing included
+
+        // Last TCP_INFO sample, all 0 until sampled
+        Timestamp tcpInfoTime;
+        uint32_t rttUs{0};
+        uint32_t rttVarUs{0};
+        uint32_t sendCongestionWindow{0};   ///< segments
+        uint32_t retransmits{0};            ///< segments retransmitted over the connection's life
+
+        /**
+         * @brief Add inOther's counters, keeping the larger peak; TCP_INFO fields are not summed
+         */
+        void accumulate(const Stats &inOther) noexcept;
+    };
+
+    /**
+     * @brief Copy of the connection's statistics
+     * @note Loop thread only; from elsewhere go through runInLoop or TcpServer::forEachConnection
+     */
+    [[nodiscard]] Stats stats() const;
+
+    /**
+     * @brief Refresh the TCP_INFO fields of stats() every inSeconds while connected
+     * @details 0 disables periodic sampling. Call before connectEstablished().
+     */
+    TcpConnection& setTcpInfoInterval(double inSeconds) noexcept
+    { m_tcpInfoInterval = inSeconds; return *this; }
+
+    /**
+     * @brief Refresh the TCP_INFO fields of stats() now
+     * @return false if the kernel refused, e.g. the socket is already closed
+     * @note Loop thread only
+     */
+    bool sampleTcpInfo();
+
+    /**
+     * @brief Bytes waiting in the output buffer, readable from any thread
+     */
+    [[nodiscard]] size_t outputBytes() const noexcept
+    { return m_bufferedOutputBytes.load(std::memory_order_relaxed); }
 
     // Callback setters
     TcpConnection& setConnectionCallback(ConnectionCallback inCb) noexcept
@@ -63,18 +141,130 @@ public:
         return *this; 
     }
 
+    /**
+     * @brief Called once when the output buffer drains to the low water mark
+     *        after having reached the high water mark
+     */
+    TcpConnection& setLowWaterMarkCallback(LowWaterMarkCallback inCb, size_t inLowWaterMark) noexcept
+    {
+        m_lowWaterMarkCallback = std::move(inCb);
+        m_lowWaterMark = inLowWaterMark;
+        return *this;
+    }
+
     TcpConnection& setCloseCallback(CloseCallback inCb) noexcept
     { m_closeCallback = std::move(inCb); return *this; }
 
+    /**
+     * @brief Account this connection's output buffer in a server-wide budget
+     * @note Call before connectEstablished(); the budget must know this loop
+     */
+    TcpConnection& setOutputBudget(std::shared_ptr<OutputBudget> inBudget) noexcept;
+
+    /**
+     * @brief Token-bucket limits consulted by handleRead/handleWrite
+     * @details When a bucket runs dry the connection stops reading (or writing)
+     *          and a loop timer resumes it once tokens are available again.
+     *          A message is one read followed by one MessageCallback invocation.
+     *          A rate <= 0 disables the limit. Call before connectEstablished()
+     *          or from the loop thread.
+     */
+    TcpConnection& setReadRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept;
+    TcpConnection& setWriteRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept;
+    TcpConnection& setMessageRateLimit(double inMessagesPerSecond, double inBurst) noexcept;
+
+    /**
+     * @brief Inbound byte bucket shared with other connections, e.g. per client IP
+     */
+    TcpConnection& setReadRateGroup(std::shared_ptr<SharedTokenBucket> inGroup) noexcept;
+
+    /**
+     * @brief Scheduling class used by the loop's WriteScheduler
+     * @details Higher classes get a larger share of each iteration's write budget
+     *          and first pick of what others leave unused; no class is starved
+     */
+    enum WritePriority : uint8_t
+    {
+        kWritePriorityHigh = 0,     // latency-sensitive replies
+        kWritePriorityNormal = 1,
+        kWritePriorityBulk = 2,     // bulk transfers
+    };
+
+    /**
+     * @brief Share of the loop's write budget relative to connections of the same priority
+     * @details Only used when EventLoop::enableWriteScheduler() is active
+     */
+    TcpConnection& setWriteWeight(uint32_t inWeight) noexcept
+    { m_writeWeight = inWeight; return *this; }
+
+    TcpConnection& setWritePriority(WritePriority inPriority) noexcept
+    { m_writePriority = inPriority; return *this; }
+
+    [[nodiscard]] uint32_t getWriteWeight() const noexcept { return m_writeWeight; }
+    [[nodiscard]] WritePriority getWritePriority() const noexcept { return m_writePriority; }
+
+    /**
+     * @brief Writes at most inMaxBytes of pending output on behalf of the WriteScheduler
+     * @param outWritten Bytes actually written
+     */
+    WriteScheduler::WriteResult writeScheduled(size_t inMaxBytes, size_t *outWritten);
+
+    /**
+     * @brief Per-iteration read budgets overriding the loop defaults
+     * @details At most inMessages read + MessageCallback rounds and inBytes bytes are
+     *          handled per loop iteration; a connection with input left is re-queued
+     *          as ready for the next iteration. 0 keeps the EventLoop setting.
+     * @see EventLoop::setReadBudget
+     */
+    TcpConnection& setReadBudget(size_t inBytes, size_t inMessages) noexcept
+    {
+        m_readBytesBudget = inBytes;
+        m_readMessagesBudget = inMessages;
+        return *this;
+    }
+
+    /**
+     * @brief Link a connection whose reads are paused while this one is congested
+     * @details When this connection's output buffer reaches the high water mark,
+     *          reading on inPeer is paused; it resumes once the output drains to the
+     *          low water mark or this connection closes. A peer linked to several
+     *          connections stays paused until all of them have drained. Typical use
+     *          is a proxy where inPeer produces the data written to this connection.
+     *          Passing this connection itself pauses its own reads. Only a weak
+     *          reference is kept.
+     *          Relinking while congested moves the pause from the old peer to inPeer.
+     * @note Loop thread only
+     */
+    TcpConnection& setBackpressurePeer(const TcpConnectionPtr &inPeer);
+
+    /**
+     * @brief Enable automatic write coalescing (auto-cork)
+     * @details When enabled, in-loop sends only append to the output buffer; the
+     *          loop flushes the connection once after the current iteration.
+     */
+    TcpConnection& setAutoCork(bool inOn) noexcept
+    { m_autoCork = inOn; return *this; }
+
+    [[nodiscard]] bool isAutoCork() const noexcept { return m_autoCork; }
+
+    /**
+     * @brief Apply per-connection socket options, e.g. from a SocketProfile
+     * @details With quickAck set, TCP_QUICKACK is re-armed once per readiness event that read data.
+     */
+    TcpConnection& setSocketOptions(const SocketOptions &inOptions);
+
     /**
      * @brief Establish the connection
-     * @details Called when the connection is successfully established
+     * @details Called when the connection is successfully established. From here
+     *          until connectDestroyed() the connection keeps itself alive, so its
+     *          Channel needs no tie() and loop-internal paths use ConnectionRef.
      */
     void connectEstablished();
 
     /**
      * @brief Destroy the connection
-     * @details Called when the connection is being torn down
+     * @details Called when the connection is being torn down; drops the self
+     *          reference once no ConnectionRef is left
      */
     void connectDestroyed();
 
@@ -84,6 +274,59 @@ public:
      */
     void send(std::string_view inMsg);
 
+    /**
+     * @brief Reserve a writable region directly in the output buffer
+     * @param inLen Minimum number of bytes the caller intends to serialize
+     * @return Pointer to at least inLen writable bytes inside the output buffer
+     * @note Loop thread only. The pointer is invalidated by any later send/reserve.
+     *       Nothing is sent until commitSend() is called.
+     */
+    [[nodiscard]] char* reserveSend(size_t inLen);
+
+    /**
+     * @brief Commit bytes serialized into the output buffer and schedule a flush
+     * @param inLen Number of bytes written into the region returned by reserveSend();
+     *              0 when the data was appended through outputBuffer() directly
+     * @details The write is attempted once, after the current batch of events and
+     *          pending functors (see EventLoop::queueFlush), so several commits in
+     *          one iteration share a syscall.
+     * @note Loop thread only
+     */
+    void commitSend(size_t inLen);
+
+    /**
+     * @brief Direct access to the output buffer for typed serialization
+     * @details Use Buffer::appendInt32() etc., then call commitSend(0)
+     * @note Loop thread only
+     */
+    [[nodiscard]] Buffer* outputBuffer() noexcept { return &m_outputBuffer; }
+
+    /**
+     * @brief Resume reading from the socket
+     * @details Thread-safe. Reading only restarts when no other pause
+     *          (e.g. backpressure from a linked peer) is still in effect.
+     */
+    void startRead();
+
+    /**
+     * @brief Stop reading from the socket until startRead() is called
+     * @details Thread-safe. Pending input stays in the kernel buffer, which
+     *          makes TCP flow control push back on the sender.
+     */
+    void stopRead();
+
+    /**
+     * @brief Pause or resume reading because the server output budget is overloaded
+     * @details Thread-safe; independent of stopRead()/startRead()
+     */
+    void setOverloadPaused(bool inPaused);
+
+    /**
+     * @brief Close the connection immediately, discarding unsent output
+     * @details Thread-safe
+     */
+    void forceClose();
+
     /**
      * @brief Initiate connection shutdown
      * @details Gracefully closes the write end of the connection
@@ -91,6 +334,8 @@ public:
     void shutdown();
 
 private:
+    friend class ConnectionRef;
+
     enum class State 
     {
         Disconnected,
@@ -99,14 +344,49 @@ private:
         Disconnecting
     };
 
+    /**
+     * @brief Independent reasons for pausing reads; reading resumes once all are cleared
+     */
+    enum ReadPauseReason : uint8_t
+    {
+        kPauseByUser = 1 << 0,      // stopRead()
+        kPauseByPeer = 1 << 1,      // linked connections are over their high water mark
+        kPauseByOverload = 1 << 2,  // the server output budget is overloaded
+        kPauseByRateLimit = 1 << 3, // an inbound token bucket is empty
+    };
+
     void setState(State inState) noexcept { m_state = inState; }
 
+    /**
+     * @brief Set or clear a read pause reason from any thread
+     */
+    void setReadPaused(ReadPauseReason inReason, bool inPaused);
+
+    /**
+     * @brief Set or clear a read pause reason and update the Channel accordingly
+     */
+    void setReadPausedInLoop(ReadPauseReason inReason, bool inPaused);
+
+    /**
+     * @brief Count a linked connection entering or leaving congestion, from any thread
+     * @details Reads stay paused by kPauseByPeer until every connection that
+     *          entered congestion has left it again
+     */
+    void notePeerCongestion(bool inCongested);
+    void notePeerCongestionInLoop(bool inCongested);
+
     /**
      * @brief Handle read events
      * @param inReceiveTime Timestamp when the read event occurred
      */
     void handleRead(Timestamp inReceiveTime);
 
+    /**
+     * @brief Reads and dispatches input within the read budgets
+     * @return Bytes read during this readiness event
+     */
+    size_t readInput(Timestamp inReceiveTime);
+
     /**
      * @brief Handle write events
      */
@@ -129,24 +409,102 @@ private:
      */
     void sendInLoop(const void* inMessage, size_t inLen);
 
+    /**
+     * @brief Register this connection for the loop's end-of-iteration flush
+     * @details Does nothing if a flush is already queued or EPOLLOUT is armed
+     */
+    void scheduleFlush();
+
+    /**
+     * @brief Write the output buffer once if no EPOLLOUT-driven write is in progress
+     * @details Runs from EventLoop::doPendingFlushes() after scheduleFlush()
+     */
+    void flushOutputInLoop();
+
+    /**
+     * @brief Queue the high water mark callback if the output buffer just crossed it
+     *        and pause the backpressure peer
+     */
+    void checkHighWaterMark(size_t inOldLen, size_t inNewLen);
+
+    /**
+     * @brief After the output buffer shrank, fire the low water mark callback and
+     *        resume the backpressure peer if the buffer drained far enough
+     */
+    void checkLowWaterMark();
+
+    /**
+     * @brief Leave the high water mark state and resume the backpressure peer
+     * @details No-op unless over the high water mark; used on drain, close and relink
+     */
+    void releaseBackpressure();
+
+    /**
+     * @brief Stop periodic TCP_INFO sampling, taking a final sample
+     */
+    void stopTcpInfoSampling();
+
+    /**
+     * @brief Report the current output buffer size to the output budget
+     */
+    void syncOutputBudget();
+
+    void forceCloseInLoop();
+
+    /**
+     * @brief Enable EPOLLOUT, or throttle if the outbound bucket is empty
+     */
+    void armWriting();
+
+    /**
+     * @brief Stop writing until the outbound bucket refills (loop timer)
+     */
+    void throttleWrite();
+
+    /**
+     * @brief Stop reading until the inbound buckets refill (loop timer)
+     */
+    void throttleRead();
+
+    /**
+     * @brief Bytes the next read may consume, 0 if any inbound bucket is empty
+     */
+    size_t readAllowance();
+
     /**
      * @brief Perform shutdown in the event loop
      */
     void shutdownInLoop();
 
+    /**
+     * @brief Drops the self reference; may destroy this connection, so call it last
+     */
+    void releaseSelf();
+
 private: // attributes
     // Essential components
     EventLoop* const m_loop;  // subLoop that manages this connection
-    const std::string m_name;
+    const uint64_t m_id;
     std::atomic<State> m_state{State::Disconnected};
     std::atomic<bool> m_reading{false};
 
-    // Socket management
-    std::unique_ptr<Socket> m_socket;   // RAII handle for socket fd
-    std::unique_ptr<Channel> m_channel; // Channel for event handling
+    // Loop-internal lifetime, see ConnectionRef; loop thread only
+    TcpConnectionPtr m_self;   // set while established or referenced by a ConnectionRef
+    uint32_t m_loopRefs{0};    // live ConnectionRef handles
+    bool m_destroyed{false};   // connectDestroyed() has run
+
+    // Socket management, stored inline to keep a connection in one allocation
+    Socket m_socket;    // RAII handle for socket fd
+    Channel m_channel;  // Channel for event handling
+
+    // Name and local address, built on first use
+    std::shared_ptr<const std::string> m_namePrefix;
+    mutable std::string m_name;
+    mutable std::once_flag m_nameOnce;
+    mutable InetAddress m_localAddr;
+    mutable std::once_flag m_localAddrOnce;
 
     // Connection addresses
-    const InetAddress m_localAddr;
     const InetAddress m_peerAddr;
 
     // Callback handlers
@@ -154,12 +512,75 @@ private: // attributes
     MessageCallback m_messageCallback;            // Read/write message callback
     WriteCompleteCallback m_writeCompleteCallback;// Write completion callback
     HighWaterMarkCallback m_highWaterMarkCallback;// High water mark callback
+    LowWaterMarkCallback m_lowWaterMarkCallback;  // Low water mark callback
     CloseCallback m_closeCallback;               // Connection close callback
     
     // Configuration
     size_t m_highWaterMark{0};
+    size_t m_lowWaterMark{0};
+    bool m_overHighWaterMark{false}; // reached high water mark and not yet drained to low water mark
+    uint8_t m_readPauseReasons{0};   // ReadPauseReason bits, loop thread only
+    uint32_t m_congestedPeers{0};    // linked connections over their high water mark, loop thread only
+    std::weak_ptr<TcpConnection> m_backpressurePeer; // reads paused while we are congested
+
+    // Read fairness, 0 means use the loop's budget
+    size_t m_readBytesBudget{0};
+    size_t m_readMessagesBudget{0};
+
+    // Fair write scheduling
+    uint32_t m_writeWeight{1};
+    WritePriority m_writePriority{kWritePriorityNormal};
+
+    // Rate limiting, loop thread only
+    TokenBucket m_readLimiter;     // inbound bytes
+    TokenBucket m_writeLimiter;    // outbound bytes
+    TokenBucket m_messageLimiter;  // inbound reads/MessageCallback invocations
+    std::shared_ptr<SharedTokenBucket> m_readGroupLimiter;
+    bool m_readThrottled{false};
+    bool m_writeThrottled{false};
+
+    // Server-wide output accounting
+    std::shared_ptr<OutputBudget> m_outputBudget;
+    OutputBudget::Slot *m_budgetSlot{nullptr};       // counter of m_loop inside m_outputBudget
+    std::atomic<size_t> m_bufferedOutputBytes{0};    // bytes last reported to the budget
+    bool m_flushPending{false};  // a flush is already queued for this iteration
+    bool m_autoCork{false};      // coalesce in-loop sends into one write per iteration
+    bool m_quickAck{false};      // re-arm TCP_QUICKACK once per readiness event that read data
+
+    // Statistics, loop thread only
+    Stats m_stats;
+    int64_t m_overHighWaterMarkSince{0};  // monotonicNanos() when m_overHighWaterMark was set
+    double m_tcpInfoInterval{0};
+    TimerId m_tcpInfoTimer;
 
     // I/O buffers
     Buffer m_inputBuffer;   // Receive buffer
     Buffer m_outputBuffer;  // Send buffer
 };
+
+inline ConnectionRef::ConnectionRef(TcpConnection *inConn)
+    : m_conn(inConn)
+{
+    ++m_conn->m_loopRefs;
+    if (!m_conn->m_self)
+    {
+        m_conn->m_self = m_conn->shared_from_this();
+    }
+}
+
+inline ConnectionRef::ConnectionRef(const ConnectionRef &inOther) noexcept
+    : m_conn(inOther.m_conn)
+{
+    if (m_conn != nullptr)
+    {
+        ++m_conn->m_loopRefs;
+    }
+}
+
+inline ConnectionRef::~ConnectionRef()
+{
+    if (m_conn != nullptr && --m_conn->m_loopRefs == 0 && m_conn->m_destroyed)
+    {
+        m_conn->releaseSelf();
+    }
+}
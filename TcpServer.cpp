@@ -4,6 +4,10 @@
 
 #include <string>
 #include <functional>
+#include <algorithm>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace {
     EventLoop* CheckLoopNotNull(EventLoop *inLoop)
@@ -23,10 +27,11 @@ TcpServer::TcpServer(EventLoop *inLoop,
     : m_loop(CheckLoopNotNull(inLoop))
     , m_ipPort(inListenAddr.toIpPort())
     , m_name(std::move(inName))
+    , m_connNamePrefix(std::make_shared<const std::string>(m_name + "-" + m_ipPort + "#"))
     , m_acceptor(std::make_unique<Acceptor>(inLoop, inListenAddr, inOption == Option::ReusePort))
     , m_threadPool(std::make_unique<EventLoopThreadPool>(inLoop, m_name))
-    , m_nextConnId(1)
     , m_started(0)
+    , m_admissionWaiter(std::make_shared<AdmissionWaiter>(inLoop))
 {
     // Set new connection callback using lambda
     m_acceptor->setNewConnectionCallback(
@@ -35,7 +40,46 @@ TcpServer::TcpServer(EventLoop *inLoop,
         });
 }
 
-TcpServer::~TcpServer() = default;
+TcpServer::~TcpServer()
+{
+    m_admissionWaiter->recheck = nullptr;
+    m_overloadHandler.reset();
+    if (m_outputBudget)
+    {
+        m_outputBudget->setOverloadCallback(nullptr);
+    }
+    // Each loop tears down its own connections; the shard outlives the server
+    for (const auto &shard : m_shards)
+    {
+        shard->loop->runInLoop([shard]() {
+            ConnectionMap connections;
+            connections.swap(shard->connections);
+            for (const auto &[id, conn] : connections)
+            {
+                conn->connectDestroyed();
+            }
+            shard->count.fetch_sub(connections.size(), std::memory_order_relaxed);
+        });
+    }
+}
+
+TcpServer& TcpServer::setOutputBudget(size_t inLimitBytes, OutputBudget::ShedPolicy inPolicy)
+{
+    m_outputBudget = std::make_shared<OutputBudget>(inLimitBytes);
+    m_shedPolicy = inPolicy;
+    m_overloadHandler = std::make_shared<std::function<void()>>([this]() { handleOverload(); });
+    // Invoked from whichever io loop crossed the threshold; the state is read again in the base loop
+    m_outputBudget->setOverloadCallback(
+        [loop = m_loop, handler = std::weak_ptr<std::function<void()>>(m_overloadHandler)](bool) {
+            loop->runInLoop([handler]() {
+                if (auto target = handler.lock())
+                {
+                    (*target)();
+                }
+            });
+        });
+    return *this;
+}
 
 void TcpServer::setThreadNum(int inNumThreads)
 {
@@ -47,72 +91,435 @@ void TcpServer::start()
     if (!m_started.exchange(true))  // Prevent multiple starts
     {
         m_threadPool->start(m_threadInitCallback);
-        m_loop->runInLoop([acceptor = m_acceptor.get()]() { acceptor->listen(); });
+        for (EventLoop *loop : m_threadPool->getAllLoops())
+        {
+            m_shards.push_back(std::make_shared<ConnectionShard>(loop, m_admissionWaiter));
+        }
+        m_admissionWaiter->recheck = [this]() { recheckAdmission(); };
+        if (m_outputBudget)
+        {
+            m_outputBudget->registerLoops(m_threadPool->getAllLoops());
+        }
+        for (EventLoop *loop : m_threadPool->getAllLoops())
+        {
+            if (m_writeSchedulerBudget > 0)
+            {
+                loop->runInLoop([loop, budget = m_writeSchedulerBudget, quantum = m_writeSchedulerQuantum]() {
+                    loop->enableWriteScheduler(budget, quantum);
+                });
+            }
+            if (m_readBytesBudget > 0 || m_readMessagesBudget > 0)
+            {
+                loop->runInLoop([loop, bytes = m_readBytesBudget, messages = m_readMessagesBudget]() {
+                    loop->setReadBudget(bytes, messages);
+                });
+            }
+        }
+        m_loop->runInLoop([acceptor = m_acceptor.get(), options = m_socketOptions]() {
+            acceptor->setSocketOptions(options);
+            acceptor->listen();
+        });
     }
 }
 
 void TcpServer::newConnection(int inSockfd, const InetAddress &inPeerAddr)
 {
-    // Get the next IO loop using round-robin
-    EventLoop *ioLoop = m_threadPool->getNextLoop();
-    
-    // Create connection name
-    std::string connName = m_name + "-" + m_ipPort + "#" + std::to_string(m_nextConnId++);
+    EventLoop *ioLoop = pickLoop();
+    if (ioLoop == nullptr)
+    {
+        rejectConnection(inSockfd);
+        if (m_admissionPolicy == AdmissionPolicy::PauseAccepting)
+        {
+            setAcceptPaused(kAcceptPauseByLimit, true);
+        }
+        return;
+    }
+
+    const uint64_t connId = m_nextConnId++;
+    const std::shared_ptr<ConnectionShard> &shard = shardFor(ioLoop);
 
-    LOG_INFO("TcpServer::newConnection [{}] - new connection [{}] from {}\n",
-             m_name, connName, inPeerAddr.toIpPort());
+    LOG_INFO("TcpServer::newConnection [{}] - new connection #{} from {}\n",
+             m_name, connId, inPeerAddr.toIpPort());
 
-    // Get local address information
-    sockaddr_in local{};
-    socklen_t addrlen = sizeof(local);
-    if (::getsockname(inSockfd, reinterpret_cast<sockaddr*>(&local), &addrlen) < 0)
+    ConnectionSetup setup;
+    setup.id = connId;
+    setup.sockfd = inSockfd;
+    setup.peerAddr = inPeerAddr;
+    setup.namePrefix = m_connNamePrefix;
+    setup.connectionCallback = m_connectionCallback;
+    setup.messageCallback = m_messageCallback;
+    setup.writeCompleteCallback = m_writeCompleteCallback;
+    setup.autoCork = m_autoCork;
+    setup.socketOptions = m_socketOptions;
+    setup.tcpInfoInterval = m_tcpInfoInterval;
+    setup.outputBudget = m_outputBudget;
+    setup.pauseWhenOverloaded = m_shedPolicy == OutputBudget::ShedPolicy::PauseReads;
+    setup.readRateLimit = m_readRateLimit;
+    setup.writeRateLimit = m_writeRateLimit;
+    setup.messageRateLimit = m_messageRateLimit;
+    if (m_ipGroupRateLimit.rate > 0)
     {
-        LOG_ERROR("sockets::getLocalAddr");
+        setup.readRateGroup = ipGroupLimiter(inPeerAddr);
     }
-    InetAddress localAddr(local);
 
-    // Create new TcpConnection
-    auto conn = std::make_shared<TcpConnection>(
-        ioLoop,
-        std::move(connName), // This determines whether the parameter 'name' will be move-constructed or copy-constructed
-        inSockfd,
-        std::move(localAddr),
-        inPeerAddr
-    );
+    // Built, stored and established in its own loop
+    shard->count.fetch_add(1, std::memory_order_relaxed);
+    ioLoop->runInLoop([shard, setup = std::move(setup)]() {
+        shard->establish(shard, setup);
+    });
 
-    // Store connection
-    m_connections[conn->getName()] = conn;
+    // Stop before the next accept rather than accepting and closing it
+    if (m_admissionPolicy == AdmissionPolicy::PauseAccepting && atConnectionLimit())
+    {
+        setAcceptPaused(kAcceptPauseByLimit, true);
+    }
+}
 
-    // Set callbacks
-    conn->setConnectionCallback(m_connectionCallback)
-        .setMessageCallback(m_messageCallback)
-        .setWriteCompleteCallback(m_writeCompleteCallback)
-        .setCloseCallback([this](const TcpConnectionPtr& conn) { 
-            removeConnection(conn); 
-        });
+EventLoop* TcpServer::pickLoop()
+{
+    if (m_maxConnections > 0 && connectionCount() >= m_maxConnections)
+    {
+        return nullptr;
+    }
+    if (m_maxConnectionsPerLoop == 0)
+    {
+        return m_threadPool->getNextLoop();
+    }
+    for (size_t i = 0; i < m_shards.size(); ++i)
+    {
+        EventLoop *loop = m_threadPool->getNextLoop();
+        if (shardFor(loop)->count.load(std::memory_order_relaxed) < m_maxConnectionsPerLoop)
+        {
+            return loop;
+        }
+    }
+    return nullptr;
+}
 
-    // Establish connection
-    ioLoop->runInLoop([conn]() {
-        conn->connectEstablished();
+bool TcpServer::atConnectionLimit() const noexcept
+{
+    if (m_maxConnections > 0 && connectionCount() >= m_maxConnections)
+    {
+        return true;
+    }
+    if (m_maxConnectionsPerLoop == 0)
+    {
+        return false;
+    }
+    return std::all_of(m_shards.begin(), m_shards.end(), [this](const auto &shard) {
+        return shard->count.load(std::memory_order_relaxed) >= m_maxConnectionsPerLoop;
     });
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &inConn)
+bool TcpServer::belowResumeThreshold() const noexcept
 {
-    m_loop->runInLoop([this, conn = inConn]() {
-        removeConnectionInLoop(conn);
+    if (m_maxConnections > 0 && connectionCount() > m_resumeConnections)
+    {
+        return false;
+    }
+    if (m_maxConnectionsPerLoop == 0)
+    {
+        return true;
+    }
+    return std::any_of(m_shards.begin(), m_shards.end(), [this](const auto &shard) {
+        return shard->count.load(std::memory_order_relaxed) <= m_resumeConnectionsPerLoop;
     });
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &inConn)
+void TcpServer::rejectConnection(int inSockfd)
+{
+    m_admissionRejected.fetch_add(1, std::memory_order_relaxed);
+    if (!m_busyPayload.empty())
+    {
+        // Best effort: the socket is non-blocking and fresh, so this fits the send buffer
+        ::send(inSockfd, m_busyPayload.data(), m_busyPayload.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    ::close(inSockfd);
+}
+
+void TcpServer::setAcceptPaused(AcceptPauseReason inReason, bool inPaused)
+{
+    const uint8_t before = m_acceptPauseReasons;
+    m_acceptPauseReasons = inPaused ? (before | inReason) : (before & ~inReason);
+
+    if (inReason == kAcceptPauseByLimit)
+    {
+        m_admissionWaiter->waiting.store(inPaused, std::memory_order_relaxed);
+        // A close may have happened before the flag was visible to the io loops
+        if (inPaused && belowResumeThreshold())
+        {
+            m_acceptPauseReasons &= ~inReason;
+            m_admissionWaiter->waiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    if (before == 0 && m_acceptPauseReasons != 0)
+    {
+        m_acceptor->pauseAccepting();
+    }
+    else if (before != 0 && m_acceptPauseReasons == 0)
+    {
+        m_acceptor->resumeAccepting();
+    }
+}
+
+void TcpServer::recheckAdmission()
+{
+    if ((m_acceptPauseReasons & kAcceptPauseByLimit) && belowResumeThreshold())
+    {
+        setAcceptPaused(kAcceptPauseByLimit, false);
+    }
+}
+
+void TcpServer::ConnectionShard::establish(const std::shared_ptr<ConnectionShard> &inSelf,
+                                           const ConnectionSetup &inSetup)
+{
+    // Allocated from this loop's pool; name and local address are resolved on first use
+    auto conn = std::allocate_shared<TcpConnection>(
+        PoolAllocator<TcpConnection>(pool),
+        loop,
+        inSetup.id,
+        inSetup.namePrefix,
+        inSetup.sockfd,
+        inSetup.peerAddr
+    );
+
+    conn->setConnectionCallback(inSetup.connectionCallback)
+        .setMessageCallback(inSetup.messageCallback)
+        .setWriteCompleteCallback(inSetup.writeCompleteCallback)
+        .setAutoCork(inSetup.autoCork)
+        .setSocketOptions(inSetup.socketOptions)
+        .setTcpInfoInterval(inSetup.tcpInfoInterval)
+        .setOutputBudget(inSetup.outputBudget)
+        .setReadRateLimit(inSetup.readRateLimit.rate, inSetup.readRateLimit.burst)
+        .setWriteRateLimit(inSetup.writeRateLimit.rate, inSetup.writeRateLimit.burst)
+        .setMessageRateLimit(inSetup.messageRateLimit.rate, inSetup.messageRateLimit.burst)
+        .setCloseCallback([shard = inSelf](const TcpConnectionPtr& conn) {
+            shard->remove(conn);
+        });
+
+    if (inSetup.readRateGroup)
+    {
+        conn->setReadRateGroup(inSetup.readRateGroup);
+    }
+
+    if (inSetup.outputBudget && inSetup.outputBudget->overloaded() && inSetup.pauseWhenOverloaded)
+    {
+        conn->setOverloadPaused(true);
+    }
+
+    connections.emplace(conn->getId(), conn);
+    conn->connectEstablished();
+}
+
+void TcpServer::ConnectionShard::remove(const TcpConnectionPtr &inConn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [{}] - connection {}\n",
-             m_name, inConn->getName());
+    LOG_INFO("TcpServer::ConnectionShard::remove - connection #{}\n", inConn->getId());
 
-    m_connections.erase(inConn->getName());
-    EventLoop *ioLoop = inConn->getLoop();
-    
-    ioLoop->queueInLoop([conn = inConn]() {
+    if (connections.erase(inConn->getId()) > 0)
+    {
+        count.fetch_sub(1, std::memory_order_relaxed);
+        closedTraffic.accumulate(inConn->stats());
+        if (admission->waiting.load(std::memory_order_relaxed))
+        {
+            admission->baseLoop->queueInLoop([waiter = admission]() {
+                if (waiter->recheck)
+                {
+                    waiter->recheck();
+                }
+            });
+        }
+    }
+    // Deferred: the connection's Channel is still handling the close event
+    loop->queueInLoop([conn = inConn]() {
         conn->connectDestroyed();
     });
 }
+
+size_t TcpServer::connectionCount() const noexcept
+{
+    size_t total = 0;
+    for (const auto &shard : m_shards)
+    {
+        total += shard->count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void TcpServer::forEachConnection(std::function<void(const TcpConnectionPtr&)> inFn)
+{
+    auto fn = std::make_shared<const std::function<void(const TcpConnectionPtr&)>>(std::move(inFn));
+    for (const auto &shard : m_shards)
+    {
+        shard->loop->runInLoop([shard, fn]() {
+            for (const auto &[id, conn] : shard->connections)
+            {
+                (*fn)(conn);
+            }
+        });
+    }
+}
+
+void TcpServer::collectLoopStats(EventLoop *inReplyLoop, LoopStatsCallback inDone)
+{
+    struct Collection
+    {
+        std::vector<LoopStats> results;
+        std::atomic<size_t> remaining{0};
+        LoopStatsCallback done;
+    };
+    auto collection = std::make_shared<Collection>();
+    collection->results.resize(m_shards.size());
+    collection->remaining = m_shards.size();
+    collection->done = std::move(inDone);
+    if (m_shards.empty())
+    {
+        inReplyLoop->queueInLoop([collection]() { collection->done({}); });
+        return;
+    }
+
+    for (size_t i = 0; i < m_shards.size(); ++i)
+    {
+        m_shards[i]->loop->runInLoop([shard = m_shards[i], collection, inReplyLoop, i]() {
+            LoopStats &stats = collection->results[i];
+            stats.loop = shard->loop;
+            stats.metrics = shard->loop->metricsSnapshot();
+            stats.connections = shard->connections.size();
+            stats.traffic = shard->closedTraffic;
+            for (const auto &[id, conn] : shard->connections)
+            {
+                stats.traffic.accumulate(conn->stats());
+            }
+            if (collection->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                inReplyLoop->queueInLoop([collection]() {
+                    collection->done(std::move(collection->results));
+                });
+            }
+        });
+    }
+}
+
+void TcpServer::broadcast(std::string_view inMsg)
+{
+    forEachConnection([msg = std::string(inMsg)](const TcpConnectionPtr &conn) {
+        conn->send(msg);
+    });
+}
+
+void TcpServer::handleOverload()
+{
+    const bool overloaded = m_outputBudget->overloaded();
+    if (overloaded == m_overloadApplied)
+    {
+        return;
+    }
+    m_overloadApplied = overloaded;
+    switch (m_shedPolicy)
+    {
+    case OutputBudget::ShedPolicy::PauseReads:
+        forEachConnection([overloaded](const TcpConnectionPtr &conn) {
+            conn->setOverloadPaused(overloaded);
+        });
+        break;
+    case OutputBudget::ShedPolicy::RejectAccepts:
+        setAcceptPaused(kAcceptPauseByOverload, overloaded);
+        break;
+    case OutputBudget::ShedPolicy::CloseWorst:
+        if (overloaded)
+        {
+            closeWorstOffenders();
+        }
+        break;
+    case OutputBudget::ShedPolicy::None:
+        break;
+    }
+}
+
+void TcpServer::closeWorstOffenders()
+{
+    const size_t buffered = m_outputBudget->bufferedBytes();
+    if (buffered <= m_outputBudget->lowMark())
+    {
+        return;
+    }
+    const size_t excess = buffered - m_outputBudget->lowMark();
+
+    // Each loop sheds its share of the excess, proportional to what it buffers
+    for (const auto &shard : m_shards)
+    {
+        const OutputBudget::Slot *slot = m_outputBudget->slotFor(shard->loop);
+        const int64_t loopBytes = slot ? slot->bytes.load(std::memory_order_relaxed) : 0;
+        if (loopBytes <= 0)
+        {
+            continue;
+        }
+        const size_t share = static_cast<size_t>(
+            static_cast<double>(excess) * static_cast<double>(loopBytes) / static_cast<double>(buffered)) + 1;
+
+        shard->loop->runInLoop([shard, share, name = m_name]() {
+            size_t remaining = share;
+            std::vector<std::pair<size_t, TcpConnectionPtr>> offenders;
+            offenders.reserve(shard->connections.size());
+            for (const auto &[id, conn] : shard->connections)
+            {
+                offenders.emplace_back(conn->outputBytes(), conn);
+            }
+            std::sort(offenders.begin(), offenders.end(),
+                      [](const auto &a, const auto &b) { return a.first > b.first; });
+
+            for (const auto &[bytes, conn] : offenders)
+            {
+                if (remaining == 0 || bytes == 0)
+                {
+                    break;
+                }
+                LOG_ERROR("TcpServer::closeWorstOffenders [{}] - closing {} holding {} bytes \n",
+                          name, conn->getName(), bytes);
+                conn->forceClose();
+                remaining -= std::min(remaining, bytes);
+            }
+        });
+    }
+}
+
+const std::shared_ptr<TcpServer::ConnectionShard>& TcpServer::shardFor(EventLoop *inLoop) const
+{
+    for (const auto &shard : m_shards)
+    {
+        if (shard->loop == inLoop)
+        {
+            return shard;
+        }
+    }
+    LOG_FATAL("TcpServer::shardFor [{}] - unknown loop\n", m_name);
+    return m_shards.front();
+}
+
+std::shared_ptr<SharedTokenBucket> TcpServer::ipGroupLimiter(const InetAddress &inPeerAddr)
+{
+    const uint32_t ip = ntohl(inPeerAddr.getSockAddr()->sin_addr.s_addr);
+    const uint32_t mask = (m_ipGroupPrefixLength <= 0) ? 0
+                        : (m_ipGroupPrefixLength >= 32) ? ~0u
+                        : ~0u << (32 - m_ipGroupPrefixLength);
+    const uint32_t group = ip & mask;
+
+    auto &entry = m_ipGroupLimiters[group];
+    auto limiter = entry.lock();
+    if (!limiter)
+    {
+        limiter = std::make_shared<SharedTokenBucket>(m_ipGroupRateLimit.rate, m_ipGroupRateLimit.burst);
+        entry = limiter;
+    }
+
+    // Groups live as long as one of their connections does
+    if (m_ipGroupLimiters.size() >= m_ipGroupSweepAt)
+    {
+        for (auto it = m_ipGroupLimiters.begin(); it != m_ipGroupLimiters.end();)
+        {
+            it = it->second.expired() ? m_ipGroupLimiters.erase(it) : std::next(it);
+        }
+        m_ipGroupSweepAt = std::max<size_t>(1024, m_ipGroupLimiters.size() * 2);
+    }
+    return limiter;
+}
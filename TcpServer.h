@@ -8,12 +8,16 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "OutputBudget.h"
+#include "BlockPool.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <string_view>
+#include <vector>
 
 
 /**
@@ -27,7 +31,7 @@ class TcpServer final : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
 
     enum class Option
     {
@@ -35,6 +39,15 @@ public:
         ReusePort,
     };
 
+    /**
+     * @brief What happens to connections arriving while a connection limit is reached
+     */
+    enum class AdmissionPolicy
+    {
+        PauseAccepting,  // stop reading the listening socket; connections wait in the backlog
+        Reject,          // accept, send the busy payload if any, and close
+    };
+
     /**
      * @brief Constructs a TCP server
      * @param inLoop The main event loop
@@ -76,10 +89,177 @@ public:
         return *this;
     }
 
+    /**
+     * @brief Enable auto-cork on every new connection
+     * @see TcpConnection::setAutoCork
+     */
+    TcpServer& setAutoCork(bool inOn) noexcept
+    {
+        m_autoCork = inOn;
+        return *this;
+    }
+
+    /**
+     * @brief Cap the bytes buffered in output buffers across all connections
+     * @param inLimitBytes Server-wide limit, see OutputBudget for the thresholds
+     * @param inPolicy How load is shed while the budget is overloaded
+     * @note Must be called before start()
+     */
+    TcpServer& setOutputBudget(size_t inLimitBytes, OutputBudget::ShedPolicy inPolicy);
+
+    /**
+     * @brief Gets the output budget, nullptr if none was configured
+     */
+    [[nodiscard]] const OutputBudget* getOutputBudget() const noexcept { return m_outputBudget.get(); }
+
+    /**
+     * @brief Per-connection token-bucket limits applied to new connections
+     * @see TcpConnection::setReadRateLimit
+     */
+    TcpServer& setReadRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept
+    {
+        m_readRateLimit = {inBytesPerSecond, inBurstBytes};
+        return *this;
+    }
+
+    TcpServer& setWriteRateLimit(double inBytesPerSecond, double inBurstBytes) noexcept
+    {
+        m_writeRateLimit = {inBytesPerSecond, inBurstBytes};
+        return *this;
+    }
+
+    TcpServer& setMessageRateLimit(double inMessagesPerSecond, double inBurst) noexcept
+    {
+        m_messageRateLimit = {inMessagesPerSecond, inBurst};
+        return *this;
+    }
+
+    /**
+     * @brief Share one inbound byte bucket between all connections from the same IP group
+     * @param inPrefixLength Leading bits of the IPv4 address that form the group
+     *                       (32 = per address, 24 = per /24 subnet)
+     */
+    TcpServer& setIpGroupReadRateLimit(double inBytesPerSecond, double inBurstBytes, int inPrefixLength = 32) noexcept
+    {
+        m_ipGroupRateLimit = {inBytesPerSecond, inBurstBytes};
+        m_ipGroupPrefixLength = inPrefixLength;
+        return *this;
+    }
+
+    /**
+     * @brief Enable weighted fair write scheduling on every io loop when the server starts
+     * @see EventLoop::enableWriteScheduler
+     */
+    TcpServer& setWriteScheduling(size_t inBytesPerIteration, size_t inQuantum) noexcept
+    {
+        m_writeSchedulerBudget = inBytesPerIteration;
+        m_writeSchedulerQuantum = inQuantum;
+        return *this;
+    }
+
+    /**
+     * @brief Set the per-connection read budget of every io loop when the server starts
+     * @see EventLoop::setReadBudget
+     */
+    TcpServer& setReadBudget(size_t inBytesPerIteration, size_t inMessagesPerIteration) noexcept
+    {
+        m_readBytesBudget = inBytesPerIteration;
+        m_readMessagesBudget = inMessagesPerIteration;
+        return *this;
+    }
+
+    /**
+     * @brief Socket options for the listening socket and every accepted connection
+     * @note Must be called before start()
+     */
+    TcpServer& setSocketOptions(const SocketOptions &inOptions) noexcept
+    {
+        m_socketOptions = inOptions;
+        return *this;
+    }
+
+    TcpServer& setSocketProfile(SocketProfile inProfile) noexcept
+    { return setSocketOptions(SocketOptions::forProfile(inProfile)); }
+
+    /**
+     * @brief Sample TCP_INFO of every new connection every inSeconds, 0 to disable
+     * @see TcpConnection::stats
+     */
+    TcpServer& setTcpInfoInterval(double inSeconds) noexcept
+    { m_tcpInfoInterval = inSeconds; return *this; }
+
+    /**
+     * @brief Cap the number of live connections across the server
+     * @param inMaxConnections Limit, 0 disables it
+     * @param inResumeBelow Accepting resumes once the count drops to this value;
+     *                      0 means 90% of the limit
+     * @note Must be called before start()
+     */
+    TcpServer& setMaxConnections(size_t inMaxConnections, size_t inResumeBelow = 0) noexcept
+    {
+        m_maxConnections = inMaxConnections;
+        m_resumeConnections = inResumeBelow > 0 ? inResumeBelow : inMaxConnections * 9 / 10;
+        return *this;
+    }
+
+    /**
+     * @brief Cap the number of live connections served by each io loop
+     * @details A new connection goes to the next loop in round-robin order that is
+     *          below its cap; the server is full once every loop is at its cap.
+     * @see setMaxConnections
+     */
+    TcpServer& setMaxConnectionsPerLoop(size_t inMaxConnections, size_t inResumeBelow = 0) noexcept
+    {
+        m_maxConnectionsPerLoop = inMaxConnections;
+        m_resumeConnectionsPerLoop = inResumeBelow > 0 ? inResumeBelow : inMaxConnections * 9 / 10;
+        return *this;
+    }
+
+    /**
+     * @brief Choose how connections beyond the limits are handled
+     * @param inBusyPayload Sent best-effort before closing under AdmissionPolicy::Reject
+     */
+    TcpServer& setAdmissionPolicy(AdmissionPolicy inPolicy, std::string inBusyPayload = {})
+    {
+        m_admissionPolicy = inPolicy;
+        m_busyPayload = std::move(inBusyPayload);
+        return *this;
+    }
+
+    /**
+     * @brief Connections closed on arrival because a connection limit was reached
+     */
+    [[nodiscard]] uint64_t admissionRejectedCount() const noexcept
+    { return m_admissionRejected.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Maximum number of accept() calls per readiness event
+     * @see Acceptor::setBatchSize
+     */
+    TcpServer& setAcceptBatchSize(int inBatchSize)
+    {
+        m_acceptor->setBatchSize(inBatchSize);
+        return *this;
+    }
+
+    /**
+     * @brief Accept and rejection counters of the listening socket
+     */
+    [[nodiscard]] Acceptor::Stats acceptStats() const noexcept { return m_acceptor->stats(); }
+
     // Getters
     [[nodiscard]] const std::string& getIpPort() const noexcept { return m_ipPort; }
     [[nodiscard]] const std::string& getName() const noexcept { return m_name; }
     [[nodiscard]] EventLoop* getLoop() const noexcept { return m_loop; }
+    /**
+     * @brief Loops serving connections, e.g. for EventLoopThreadPool::metricsSnapshot()
+     */
+    [[nodiscard]] const std::shared_ptr<EventLoopThreadPool>& threadPool() const noexcept { return m_threadPool; }
+
+    /**
+     * @brief Server-wide output budget, nullptr unless setOutputBudget() was called
+     */
+    [[nodiscard]] const std::shared_ptr<OutputBudget>& outputBudget() const noexcept { return m_outputBudget; }
 
     /**
      * @brief Set the number of threads in the thread pool
@@ -94,15 +274,196 @@ public:
      */
     void start();
 
+    /**
+     * @brief Number of live connections across all loops
+     * @note Thread-safe; connections being established or torn down may be included
+     */
+    [[nodiscard]] size_t connectionCount() const noexcept;
+
+    /**
+     * @brief Invoke inFn for every connection, in the loop that owns it
+     * @details Asynchronous: each loop visits its own connections the next time it
+     *          runs pending functors. Does nothing before start().
+     */
+    void forEachConnection(std::function<void(const TcpConnectionPtr&)> inFn);
+
+    /**
+     * @brief Send inMsg to every connected connection
+     * @see forEachConnection
+     */
+    void broadcast(std::string_view inMsg);
+
+    /**
+     * @brief Statistics of one io loop, gathered by that loop
+     */
+    struct LoopStats
+    {
+        EventLoop *loop{nullptr};
+        LoopMetricsSnapshot metrics;   ///< see EventLoop::setMetricsEnabled
+        size_t connections{0};
+        TcpConnection::Stats traffic;  ///< counters summed over live and closed connections
+    };
+    using LoopStatsCallback = std::function<void(std::vector<LoopStats>)>;
+
+    /**
+     * @brief Collect LoopStats from every io loop, in shard order
+     * @details Each loop fills in its own entry from a queued functor, so no lock is
+     *          taken on the connection paths; inDone runs in inReplyLoop once all
+     *          loops have answered (with an empty vector before start()).
+     */
+    void collectLoopStats(EventLoop *inReplyLoop, LoopStatsCallback inDone);
+
 private:
+    /**
+     * @brief Independent reasons for pausing the acceptor; it resumes once all are cleared
+     */
+    enum AcceptPauseReason : uint8_t
+    {
+        kAcceptPauseByOverload = 1 << 0,  // output budget overloaded (ShedPolicy::RejectAccepts)
+        kAcceptPauseByLimit = 1 << 1,     // a connection limit is reached
+    };
+
+    /**
+     * @brief Lets io loops wake the base loop when a close may allow accepting again
+     * @details Shared with the shards; recheck is only touched from the base loop
+     *          and cleared when the server is destroyed.
+     */
+    struct AdmissionWaiter
+    {
+        explicit AdmissionWaiter(EventLoop *inLoop) : baseLoop(inLoop) {}
+
+        EventLoop* const baseLoop;
+        std::atomic<bool> waiting{false};  // acceptor paused by a connection limit
+        std::function<void()> recheck;
+    };
+
+    struct RateLimit
+    {
+        double rate{0.0};
+        double burst{0.0};
+    };
+
+    /**
+     * @brief Everything a new connection is configured with, captured on accept
+     * @details Lets the io loop build the connection without touching the server,
+     *          which may be gone by the time the loop gets to it
+     */
+    struct ConnectionSetup
+    {
+        uint64_t id{0};
+        int sockfd{-1};
+        InetAddress peerAddr;
+        std::shared_ptr<const std::string> namePrefix;
+        ConnectionCallback connectionCallback;
+        MessageCallback messageCallback;
+        WriteCompleteCallback writeCompleteCallback;
+        bool autoCork{false};
+        SocketOptions socketOptions;
+        double tcpInfoInterval{0};
+        std::shared_ptr<OutputBudget> outputBudget;
+        bool pauseWhenOverloaded{false};
+        RateLimit readRateLimit;
+        RateLimit writeRateLimit;
+        RateLimit messageRateLimit;
+        std::shared_ptr<SharedTokenBucket> readRateGroup;
+    };
+
+    /**
+     * @brief Slice of the connection table owned by one io loop
+     * @details The map is only touched from the owning loop, so establishing and
+     *          closing a connection never involves another thread. Shared with the
+     *          connections' close callbacks, so it may outlive the server.
+     */
+    struct ConnectionShard
+    {
+        ConnectionShard(EventLoop *inLoop, std::shared_ptr<AdmissionWaiter> inAdmission)
+            : loop(inLoop)
+            , pool(std::make_shared<BlockPool>())
+            , admission(std::move(inAdmission))
+        {}
+
+        /**
+         * @brief Creates, stores and establishes an accepted connection (owning loop)
+         * @details Allocating here keeps the pool's blocks on the loop that frees them
+         */
+        void establish(const std::shared_ptr<ConnectionShard> &inSelf, const ConnectionSetup &inSetup);
+
+        /**
+         * @brief Drops a closed connection and schedules its teardown (owning loop)
+         */
+        void remove(const TcpConnectionPtr &inConn);
+
+        EventLoop* const loop;
+        const std::shared_ptr<BlockPool> pool;  // memory recycled for this loop's connections
+        const std::shared_ptr<AdmissionWaiter> admission;
+        ConnectionMap connections;              // owning loop only
+        TcpConnection::Stats closedTraffic;     // counters of removed connections, owning loop only
+        std::atomic<size_t> count{0};           // incremented on accept, decremented on close
+    };
+
     void newConnection(int inSockfd, const InetAddress &inPeerAddr);
-    void removeConnection(const TcpConnectionPtr &inConn);
-    void removeConnectionInLoop(const TcpConnectionPtr &inConn);
+
+    /**
+     * @brief Next io loop in round-robin order with room for a connection,
+     *        nullptr if a connection limit is reached (base loop)
+     */
+    EventLoop* pickLoop();
+
+    /**
+     * @brief Whether the next connection would exceed a limit
+     */
+    [[nodiscard]] bool atConnectionLimit() const noexcept;
+
+    /**
+     * @brief Whether enough connections closed to accept again
+     */
+    [[nodiscard]] bool belowResumeThreshold() const noexcept;
+
+    /**
+     * @brief Close a connection the server has no room for
+     */
+    void rejectConnection(int inSockfd);
+
+    /**
+     * @brief Pause the acceptor for inReason, or clear inReason and resume if no
+     *        other reason remains (base loop)
+     */
+    void setAcceptPaused(AcceptPauseReason inReason, bool inPaused);
+
+    /**
+     * @brief Resume accepting if the connection count dropped below the thresholds
+     */
+    void recheckAdmission();
+
+    /**
+     * @brief Shard owned by inLoop (created in start())
+     */
+    const std::shared_ptr<ConnectionShard>& shardFor(EventLoop *inLoop) const;
+
+    /**
+     * @brief Applies m_shedPolicy for the current output budget state (base loop)
+     * @details Reads OutputBudget::overloaded() instead of trusting the order in
+     *          which io threads queued their transitions; repeated calls for the
+     *          same state do nothing.
+     */
+    void handleOverload();
+
+    /**
+     * @brief Force-closes the connections with the largest output buffers until
+     *        the budget is expected to fall back to its low mark (base loop)
+     */
+    void closeWorstOffenders();
+
+    /**
+     * @brief Finds or creates the shared inbound bucket for a peer's IP group (base loop)
+     */
+    std::shared_ptr<SharedTokenBucket> ipGroupLimiter(const InetAddress &inPeerAddr);
 
     // Essential server components
     EventLoop* const m_loop;  // baseLoop defined by user
     const std::string m_ipPort;
     const std::string m_name;
+    const std::shared_ptr<const std::string> m_connNamePrefix;  // "name-ip:port#", shared by all connections
     std::unique_ptr<Acceptor> m_acceptor;  // runs in mainLoop, monitors new connection events
     std::shared_ptr<EventLoopThreadPool> m_threadPool;  // one loop per thread
 
@@ -114,6 +475,45 @@ private:
 
     // Server state
     std::atomic<bool> m_started{false};
-    std::atomic<int> m_nextConnId{1};
-    ConnectionMap m_connections;  // stores all connections
+    uint64_t m_nextConnId{1};  // base loop only
+    bool m_autoCork{false};       // applied to connections created after the change
+    SocketOptions m_socketOptions;
+    double m_tcpInfoInterval{0};  // applied to connections created after the change
+
+    // Output memory budget
+    std::shared_ptr<OutputBudget> m_outputBudget;
+    OutputBudget::ShedPolicy m_shedPolicy{OutputBudget::ShedPolicy::None};
+    bool m_overloadApplied{false};  // state handleOverload() last acted on, base loop only
+    // Target of the transitions queued to the base loop; reset by the destructor
+    // so that transitions still queued then are dropped
+    std::shared_ptr<std::function<void()>> m_overloadHandler;
+
+    // Write scheduling, 0 budget means disabled
+    size_t m_writeSchedulerBudget{0};
+    size_t m_writeSchedulerQuantum{0};
+
+    // Read fairness, 0 messages means keep the loop defaults
+    size_t m_readBytesBudget{0};
+    size_t m_readMessagesBudget{0};
+
+    // Rate limits applied to new connections
+    RateLimit m_readRateLimit;
+    RateLimit m_writeRateLimit;
+    RateLimit m_messageRateLimit;
+    RateLimit m_ipGroupRateLimit;
+    int m_ipGroupPrefixLength{32};
+    std::unordered_map<uint32_t, std::weak_ptr<SharedTokenBucket>> m_ipGroupLimiters;  // base loop only
+    size_t m_ipGroupSweepAt{1024};  // prune expired groups when the map reaches this size
+    // Admission control, 0 disables a limit
+    size_t m_maxConnections{0};
+    size_t m_resumeConnections{0};
+    size_t m_maxConnectionsPerLoop{0};
+    size_t m_resumeConnectionsPerLoop{0};
+    AdmissionPolicy m_admissionPolicy{AdmissionPolicy::PauseAccepting};
+    std::string m_busyPayload;
+    std::atomic<uint64_t> m_admissionRejected{0};
+    uint8_t m_acceptPauseReasons{0};  // AcceptPauseReason bits, base loop only
+    std::shared_ptr<AdmissionWaiter> m_admissionWaiter;
+
+    std::vector<std::shared_ptr<ConnectionShard>> m_shards;  // one per io loop, fixed after start()
 };
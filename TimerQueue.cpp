@@ -0,0 +1,147 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+
+namespace
+{
+std::atomic<int64_t> s_numCreated{0};
+
+int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:{} \n", errno);
+    }
+    return timerfd;
+}
+
+timespec howMuchTimeFromNow(Timestamp inWhen)
+{
+    int64_t microseconds = inWhen.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+    if (microseconds < 100)
+    {
+        microseconds = 100;  // a zero it_value would disarm the timerfd
+    }
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+}  // namespace
+
+TimerQueue::TimerQueue(EventLoop *inLoop)
+    : m_loop(inLoop)
+    , m_timerfd(createTimerfd())
+    , m_timerfdChannel(inLoop, m_timerfd)
+{
+    m_timerfdChannel.setReadCallback([this](Timestamp) { handleRead(); });
+    m_timerfdChannel.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    m_timerfdChannel.disableAll();
+    m_timerfdChannel.remove();
+    ::close(m_timerfd);
+}
+
+TimerId TimerQueue::addTimer(TimerCallback inCallback, Timestamp inWhen, double inInterval)
+{
+    const int64_t sequence = ++s_numCreated;
+    m_loop->runInLoop([this, timer = Timer{std::move(inCallback), inWhen, inInterval, sequence}]() mutable {
+        addTimerInLoop(std::make_unique<Timer>(std::move(timer)));
+    });
+    return TimerId(sequence);
+}
+
+void TimerQueue::cancel(TimerId inTimerId)
+{
+    m_loop->runInLoop([this, sequence = inTimerId.m_sequence]() { cancelInLoop(sequence); });
+}
+
+void TimerQueue::addTimerInLoop(std::unique_ptr<Timer> inTimer)
+{
+    const bool earliestChanged = m_timers.empty() || inTimer->expiration < m_timers.begin()->first;
+    m_timers.emplace(inTimer->expiration, inTimer->sequence);
+    m_timerBySequence.emplace(inTimer->sequence, std::move(inTimer));
+    if (earliestChanged && !m_callingExpiredTimers)
+    {
+        resetTimerfd();
+    }
+}
+
+void TimerQueue::cancelInLoop(int64_t inSequence)
+{
+    auto it = m_timerBySequence.find(inSequence);
+    if (it != m_timerBySequence.end())
+    {
+        m_timers.erase(Entry(it->second->expiration, inSequence));
+        m_timerBySequence.erase(it);
+    }
+    else if (m_callingExpiredTimers)
+    {
+        m_cancelingTimers.insert(inSequence);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany = 0;
+    ssize_t n = ::read(m_timerfd, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads {} bytes instead of 8 \n", n);
+    }
+
+    const Timestamp now(Timestamp::now());
+    std::vector<std::unique_ptr<Timer>> expired;
+    while (!m_timers.empty() && !(now < m_timers.begin()->first))
+    {
+        const int64_t sequence = m_timers.begin()->second;
+        m_timers.erase(m_timers.begin());
+        auto it = m_timerBySequence.find(sequence);
+        expired.push_back(std::move(it->second));
+        m_timerBySequence.erase(it);
+    }
+
+    m_callingExpiredTimers = true;
+    m_cancelingTimers.clear();
+    for (const auto &timer : expired)
+    {
+        m_loop->noteCallback(timer->callback.target_type());
+        timer->callback();
+    }
+    m_callingExpiredTimers = false;
+
+    for (auto &timer : expired)
+    {
+        if (timer->interval > 0 && m_cancelingTimers.count(timer->sequence) == 0)
+        {
+            timer->expiration = addTime(now, timer->interval);
+            m_timers.emplace(timer->expiration, timer->sequence);
+            m_timerBySequence.emplace(timer->sequence, std::move(timer));
+        }
+    }
+
+    if (!m_timers.empty())
+    {
+        resetTimerfd();
+    }
+}
+
+void TimerQueue::resetTimerfd()
+{
+    itimerspec newValue;
+    memset(&newValue, 0, sizeof newValue);
+    newValue.it_value = howMuchTimeFromNow(m_timers.begin()->first);
+    if (::timerfd_settime(m_timerfd, 0, &newValue, nullptr) != 0)
+    {
+        LOG_ERROR("timerfd_settime error:{} \n", errno);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Channel.h"
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+class EventLoop;
+
+/**
+ * @brief Opaque handle identifying a timer, used to cancel it
+ */
+class TimerId
+{
+public:
+    TimerId() = default;
+    explicit TimerId(int64_t inSequence) : m_sequence(inSequence) {}
+
+    bool valid() const { return m_sequence != 0; }
+
+private:
+    friend class TimerQueue;
+    int64_t m_sequence{0};
+};
+
+/**
+ * @brief Timer queue driven by a timerfd registered in the owning EventLoop
+ *
+ * Timers are ordered by expiration; the timerfd is always armed for the earliest
+ * one. Callbacks run in the loop thread. addTimer() and cancel() are thread-safe
+ * and delegate to the loop through runInLoop().
+ */
+class TimerQueue : noncopyable
+{
+public:
+    using TimerCallback = std::function<void()>;
+
+    explicit TimerQueue(EventLoop *inLoop);
+    ~TimerQueue();
+
+    /**
+     * @brief Schedules inCallback at inWhen, repeating every inInterval seconds if > 0
+     */
+    TimerId addTimer(TimerCallback inCallback, Timestamp inWhen, double inInterval);
+
+    /**
+     * @brief Cancels a timer; cancelling an expired or unknown timer is a no-op
+     */
+    void cancel(TimerId inTimerId);
+
+private:
+    struct Timer
+    {
+        TimerCallback callback;
+        Timestamp expiration;
+        double interval;    // seconds, 0 for one-shot timers
+        int64_t sequence;
+    };
+
+    using Entry = std::pair<Timestamp, int64_t>;  // expiration, sequence
+    using TimerList = std::set<Entry>;
+
+    void addTimerInLoop(std::unique_ptr<Timer> inTimer);
+    void cancelInLoop(int64_t inSequence);
+
+    /**
+     * @brief Called when the timerfd fires; runs every expired timer
+     */
+    void handleRead();
+
+    /**
+     * @brief Re-arms the timerfd for the earliest pending timer
+     */
+    void resetTimerfd();
+
+    EventLoop *m_loop;
+    const int m_timerfd;
+    Channel m_timerfdChannel;
+
+    TimerList m_timers;                                        // ordered by expiration
+    std::unordered_map<int64_t, std::unique_ptr<Timer>> m_timerBySequence;
+
+    bool m_callingExpiredTimers{false};
+    std::unordered_set<int64_t> m_cancelingTimers;  // repeating timers cancelled by their own callback
+};
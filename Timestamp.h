@@ -6,10 +6,36 @@
 class Timestamp
 {
 public:
+    static constexpr int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
     static Timestamp now();
     std::string toString() const;
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    bool operator<(const Timestamp &rhs) const { return microSecondsSinceEpoch_ < rhs.microSecondsSinceEpoch_; }
+    bool operator==(const Timestamp &rhs) const { return microSecondsSinceEpoch_ == rhs.microSecondsSinceEpoch_; }
 private:
     int64_t microSecondsSinceEpoch_;
 };
+
+/**
+ * @brief Returns the timestamp inSeconds later than inTimestamp
+ */
+inline Timestamp addTime(Timestamp inTimestamp, double inSeconds)
+{
+    const auto delta = static_cast<int64_t>(inSeconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(inTimestamp.microSecondsSinceEpoch() + delta);
+}
+
+/**
+ * @brief Returns inHigh - inLow in seconds
+ */
+inline double timeDifference(Timestamp inHigh, Timestamp inLow)
+{
+    const int64_t diff = inHigh.microSecondsSinceEpoch() - inLow.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
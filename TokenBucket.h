@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+/**
+ * @brief Token bucket limiter refilled from the monotonic clock
+ *
+ * Tokens accrue at rate() per second up to burst(). consume() may drive the
+ * balance negative (debt), which simply delays the next availability; this lets
+ * callers charge the exact number of bytes transferred after the syscall.
+ * A default-constructed bucket is disabled and never limits. Not thread-safe.
+ */
+class TokenBucket
+{
+public:
+    static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+    TokenBucket() = default;
+
+    /**
+     * @brief Enables the bucket, starting full
+     * @param inRate Tokens added per second; <= 0 disables the bucket
+     * @param inBurst Maximum number of tokens, at least 1
+     */
+    void configure(double inRate, double inBurst)
+    {
+        m_rate = inRate;
+        m_burst = std::max(inBurst, 1.0);
+        m_tokens = m_burst;
+        m_lastRefill = Clock::now();
+    }
+
+    [[nodiscard]] bool enabled() const noexcept { return m_rate > 0; }
+    [[nodiscard]] double rate() const noexcept { return m_rate; }
+    [[nodiscard]] double burst() const noexcept { return m_burst; }
+
+    /**
+     * @brief Whole tokens available now, kUnlimited if the bucket is disabled
+     */
+    size_t available()
+    {
+        if (!enabled())
+        {
+            return kUnlimited;
+        }
+        refill();
+        return m_tokens >= 1.0 ? static_cast<size_t>(m_tokens) : 0;
+    }
+
+    /**
+     * @brief Removes inCount tokens, possibly leaving a debt
+     */
+    void consume(size_t inCount)
+    {
+        if (enabled())
+        {
+            m_tokens -= static_cast<double>(inCount);
+        }
+    }
+
+    /**
+     * @brief Seconds until at least one token is available, 0 if one is now
+     */
+    double secondsUntilAvailable()
+    {
+        if (!enabled())
+        {
+            return 0.0;
+        }
+        refill();
+        return m_tokens >= 1.0 ? 0.0 : (1.0 - m_tokens) / m_rate;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void refill()
+    {
+        const auto now = Clock::now();
+        const std::chrono::duration<double> elapsed = now - m_lastRefill;
+        m_lastRefill = now;
+        m_tokens = std::min(m_burst, m_tokens + elapsed.count() * m_rate);
+    }
+
+    double m_rate{0.0};
+    double m_burst{0.0};
+    double m_tokens{0.0};
+    Clock::time_point m_lastRefill{};
+};
+
+/**
+ * @brief TokenBucket shared by several connections, possibly on different loops
+ */
+class SharedTokenBucket
+{
+public:
+    SharedTokenBucket(double inRate, double inBurst) { m_bucket.configure(inRate, inBurst); }
+
+    size_t available()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bucket.available();
+    }
+
+    void consume(size_t inCount)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bucket.consume(inCount);
+    }
+
+    double secondsUntilAvailable()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bucket.secondsUntilAvailable();
+    }
+
+private:
+    std::mutex m_mutex;
+    TokenBucket m_bucket;
+};
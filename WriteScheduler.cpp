@@ -0,0 +1,88 @@
+#include "WriteScheduler.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+
+WriteScheduler::WriteScheduler(size_t inBytesPerIteration, size_t inQuantum)
+    : m_bytesPerIteration(inBytesPerIteration)
+    , m_quantum(std::max<size_t>(inQuantum, 1))
+{
+}
+
+WriteScheduler::~WriteScheduler() = default;
+
+void WriteScheduler::enqueue(ConnectionRef inConn)
+{
+    if (m_queued.insert(inConn.get()).second)
+    {
+        const size_t priority = std::min<size_t>(inConn->getWritePriority(), kNumPriorities - 1);
+        m_queues[priority].push_back(Entry{std::move(inConn), 0});
+    }
+}
+
+void WriteScheduler::run()
+{
+    size_t activeWeight = 0;
+    for (size_t priority = 0; priority < kNumPriorities; ++priority)
+    {
+        if (!m_queues[priority].empty())
+        {
+            activeWeight += kClassWeights[priority];
+        }
+    }
+    if (activeWeight == 0)
+    {
+        return;
+    }
+
+    // Guaranteed shares first, so a busy higher class cannot starve the lower ones
+    size_t budget = m_bytesPerIteration;
+    for (size_t priority = 0; priority < kNumPriorities; ++priority)
+    {
+        if (!m_queues[priority].empty())
+        {
+            const size_t share = std::max<size_t>(m_bytesPerIteration * kClassWeights[priority] / activeWeight, 1);
+            budget -= std::min(budget, serve(m_queues[priority], std::min(share, budget)));
+        }
+    }
+    // Then whatever drained classes left over, in priority order
+    for (auto &queue : m_queues)
+    {
+        if (budget == 0)
+        {
+            break;
+        }
+        budget -= std::min(budget, serve(queue, budget));
+    }
+}
+
+size_t WriteScheduler::serve(std::deque<Entry> &ioQueue, size_t inLimit)
+{
+    size_t budget = inLimit;
+    while (!ioQueue.empty() && budget > 0)
+    {
+        // One DRR round over the connections queued at the start of the round
+        const size_t round = ioQueue.size();
+        for (size_t i = 0; i < round && budget > 0; ++i)
+        {
+            Entry entry = std::move(ioQueue.front());
+            ioQueue.pop_front();
+
+            entry.deficit += m_quantum * std::max<uint32_t>(entry.conn->getWriteWeight(), 1);
+            size_t written = 0;
+            const WriteResult result = entry.conn->writeScheduled(std::min(entry.deficit, budget), &written);
+            budget -= std::min(budget, written);
+            entry.deficit -= std::min(entry.deficit, written);
+
+            if (result == WriteResult::Pending)
+            {
+                ioQueue.push_back(std::move(entry));
+            }
+            else
+            {
+                m_queued.erase(entry.conn.get());
+            }
+        }
+    }
+    return inLimit - budget;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "ConnectionRef.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+
+/**
+ * @brief Per-EventLoop weighted fair scheduler for connection output
+ *
+ * Connections with pending output are queued instead of writing as soon as
+ * their socket is writable. Once per loop iteration run() serves them with
+ * deficit round-robin: each visit adds quantum * weight bytes of credit, and
+ * a connection writes at most its credit. The whole run is bounded by a
+ * per-iteration byte budget. Each priority class with queued connections is
+ * guaranteed a share of it proportional to kClassWeights, with DRR inside the
+ * class; budget a class leaves unused goes to the others in priority order.
+ * Connections left over keep their credit and are served first in the next
+ * iteration. Loop thread only.
+ */
+class WriteScheduler : noncopyable
+{
+public:
+    static constexpr size_t kNumPriorities = 3;  // see TcpConnection::WritePriority
+    static constexpr std::array<size_t, kNumPriorities> kClassWeights{4, 2, 1};  // high, normal, bulk
+
+    /**
+     * @brief Outcome of one scheduled write of a connection
+     */
+    enum class WriteResult
+    {
+        Done,       // nothing left to write, or the connection is closed/throttled
+        Pending,    // still has output, wrote all it was allowed to
+        Blocked,    // socket buffer full; the connection waits for EPOLLOUT
+    };
+
+    /**
+     * @param inBytesPerIteration Upper bound on bytes written by one run()
+     * @param inQuantum Credit per visit for a connection of weight 1
+     */
+    WriteScheduler(size_t inBytesPerIteration, size_t inQuantum);
+    ~WriteScheduler();
+
+    /**
+     * @brief Queues a connection that has pending output; no-op if already queued
+     */
+    void enqueue(ConnectionRef inConn);
+
+    /**
+     * @brief Serves queued connections until they drain or the budget is spent
+     */
+    void run();
+
+    /**
+     * @brief True if connections are still waiting, so the loop must not block in poll
+     */
+    [[nodiscard]] bool hasPending() const noexcept { return !m_queued.empty(); }
+
+private:
+    struct Entry
+    {
+        ConnectionRef conn;
+        size_t deficit{0};
+    };
+
+    /**
+     * @brief DRR rounds over one class until it drains or inLimit bytes are written
+     * @return Bytes written
+     */
+    size_t serve(std::deque<Entry> &ioQueue, size_t inLimit);
+
+    const size_t m_bytesPerIteration;
+    const size_t m_quantum;
+    std::array<std::deque<Entry>, kNumPriorities> m_queues;  // index 0 is served first
+    std::unordered_set<const TcpConnection*> m_queued;
+};
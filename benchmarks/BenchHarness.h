@@ -0,0 +1,406 @@
+#pragma once
+
+/**
+ * @brief Minimal harness for the microbenchmarks: CPU pinning, repetitions,
+ *        JSON results and comparison of two result files
+ *
+ * Common options:
+ *   --cpu N            pin the benchmark thread to CPU N (helper threads use --helper-cpu)
+ *   --helper-cpu N     CPU for loop threads started by a benchmark, default: same as --cpu
+ *   --repetitions N    runs per benchmark, the median is reported (default 5)
+ *   --filter TEXT      only run benchmarks whose name contains TEXT
+ *   --json FILE        also write the results to FILE
+ *   --compare BASE NEW [--threshold PCT]
+ *                      compare two JSON files instead of running; exits with 1
+ *                      if any benchmark got slower by more than PCT (default 5)
+ *                      and with 2 if the files come from different builds
+ *
+ * All results are "lower is better" (ns/op or ns). Each JSON file records the
+ * build type, compiler and flags it was built with (MUDUO_BENCH_* definitions
+ * set by benchmarks/CMakeLists.txt), so numbers from a Debug -O0 tree are
+ * never compared against a Release one.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+#ifndef MUDUO_BENCH_BUILD_TYPE
+#define MUDUO_BENCH_BUILD_TYPE "unknown"
+#endif
+#ifndef MUDUO_BENCH_COMPILER
+#define MUDUO_BENCH_COMPILER "unknown"
+#endif
+#ifndef MUDUO_BENCH_CXX_FLAGS
+#define MUDUO_BENCH_CXX_FLAGS "unknown"
+#endif
+
+namespace bench
+{
+
+/**
+ * @brief How a result file's benchmarks were built
+ */
+struct BuildInfo
+{
+    std::string buildType;
+    std::string compiler;
+    std::string cxxFlags;
+
+    bool operator==(const BuildInfo &inOther) const
+    {
+        return buildType == inOther.buildType && compiler == inOther.compiler && cxxFlags == inOther.cxxFlags;
+    }
+    bool operator!=(const BuildInfo &inOther) const { return !(*this == inOther); }
+};
+
+inline BuildInfo currentBuild()
+{
+    return BuildInfo{MUDUO_BENCH_BUILD_TYPE, MUDUO_BENCH_COMPILER, MUDUO_BENCH_CXX_FLAGS};
+}
+
+/**
+ * @brief Escapes inText for use inside a JSON string
+ */
+inline std::string jsonEscape(const std::string &inText)
+{
+    std::string escaped;
+    for (const char c : inText)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+inline int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Pins the calling thread to inCpu; no-op for a negative inCpu
+ */
+inline bool pinToCpu(int inCpu)
+{
+    if (inCpu < 0)
+    {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(inCpu, &set);
+    if (::sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+        std::fprintf(stderr, "cannot pin to CPU %d\n", inCpu);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Keeps the compiler from optimizing away a value
+ */
+template <typename T>
+inline void doNotOptimize(const T &inValue)
+{
+    asm volatile("" : : "r,m"(inValue) : "memory");
+}
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    double median{0};
+    double min{0};
+    uint64_t ops{0};
+};
+
+/**
+ * @brief Reads the results of a file written by Suite::finish()
+ * @details Relies on the one-result-per-line layout Suite writes
+ */
+inline std::map<std::string, double> readResults(const char *inPath)
+{
+    std::map<std::string, double> results;
+    std::ifstream in(inPath);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const size_t name = line.find("\"name\": \"");
+        const size_t median = line.find("\"median\": ");
+        if (name == std::string::npos || median == std::string::npos)
+        {
+            continue;
+        }
+        const size_t nameStart = name + 9;
+        const size_t nameEnd = line.find('"', nameStart);
+        results[line.substr(nameStart, nameEnd - nameStart)] = std::strtod(line.c_str() + median + 10, nullptr);
+    }
+    return results;
+}
+
+/**
+ * @brief Reads the build description of a file written by Suite::finish()
+ * @details Fields missing from older files read as "unknown"
+ */
+inline BuildInfo readBuild(const char *inPath)
+{
+    BuildInfo build{"unknown", "unknown", "unknown"};
+    std::ifstream in(inPath);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        const auto field = [&line](const char *inKey, std::string *outValue) {
+            const size_t key = line.find(inKey);
+            const size_t end = line.rfind('"');
+            if (key != std::string::npos && end != std::string::npos && end >= key + std::strlen(inKey))
+            {
+                *outValue = line.substr(key + std::strlen(inKey), end - key - std::strlen(inKey));
+            }
+        };
+        field("\"build_type\": \"", &build.buildType);
+        field("\"compiler\": \"", &build.compiler);
+        field("\"cxx_flags\": \"", &build.cxxFlags);
+    }
+    return build;
+}
+
+/**
+ * @return 0 if no benchmark regressed by more than inThresholdPercent, 1 otherwise,
+ *         2 if the files cannot be compared
+ */
+inline int compare(const char *inBase, const char *inCurrent, double inThresholdPercent)
+{
+    const auto base = readResults(inBase);
+    const auto current = readResults(inCurrent);
+    if (base.empty() || current.empty())
+    {
+        std::fprintf(stderr, "no results in %s\n", base.empty() ? inBase : inCurrent);
+        return 2;
+    }
+
+    const BuildInfo baseInfo = readBuild(inBase);
+    const BuildInfo currentInfo = readBuild(inCurrent);
+    if (baseInfo != currentInfo)
+    {
+        std::fprintf(stderr, "refusing to compare results of different builds:\n"
+                             "  %s: %s, %s, flags \"%s\"\n  %s: %s, %s, flags \"%s\"\n",
+                     inBase, baseInfo.buildType.c_str(), baseInfo.compiler.c_str(), baseInfo.cxxFlags.c_str(),
+                     inCurrent, currentInfo.buildType.c_str(), currentInfo.compiler.c_str(), currentInfo.cxxFlags.c_str());
+        return 2;
+    }
+
+    int regressions = 0;
+    std::printf("%-40s %12s %12s %9s\n", "benchmark", "base", "current", "change");
+    for (const auto &[name, value] : current)
+    {
+        const auto it = base.find(name);
+        if (it == base.end())
+        {
+            std::printf("%-40s %12s %12.2f %9s  new\n", name.c_str(), "-", value, "");
+            continue;
+        }
+        const double change = it->second > 0 ? (value - it->second) / it->second * 100.0 : 0.0;
+        const char *verdict = "";
+        if (change > inThresholdPercent)
+        {
+            verdict = "  REGRESSION";
+            ++regressions;
+        }
+        else if (change < -inThresholdPercent)
+        {
+            verdict = "  improved";
+        }
+        std::printf("%-40s %12.2f %12.2f %+8.1f%%%s\n", name.c_str(), it->second, value, change, verdict);
+    }
+    for (const auto &[name, value] : base)
+    {
+        if (current.count(name) == 0)
+        {
+            std::printf("%-40s %12.2f %12s %9s  missing\n", name.c_str(), value, "-", "");
+        }
+    }
+    std::printf("%d regression(s) above %.1f%%\n", regressions, inThresholdPercent);
+    return regressions > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Runs benchmarks according to the command line and reports their results
+ */
+class Suite
+{
+public:
+    Suite(const char *inName, int argc, char *argv[])
+        : m_name(inName)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--cpu" && hasValue)
+            {
+                m_cpu = std::atoi(argv[++i]);
+            }
+            else if (arg == "--helper-cpu" && hasValue)
+            {
+                m_helperCpu = std::atoi(argv[++i]);
+            }
+            else if (arg == "--repetitions" && hasValue)
+            {
+                m_repetitions = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (arg == "--filter" && hasValue)
+            {
+                m_filter = argv[++i];
+            }
+            else if (arg == "--json" && hasValue)
+            {
+                m_jsonPath = argv[++i];
+            }
+            else if (arg == "--compare" && i + 2 < argc)
+            {
+                m_compareBase = argv[++i];
+                m_compareCurrent = argv[++i];
+            }
+            else if (arg == "--threshold" && hasValue)
+            {
+                m_threshold = std::atof(argv[++i]);
+            }
+            else
+            {
+                std::fprintf(stderr, "Usage: %s [--cpu N] [--helper-cpu N] [--repetitions N] [--filter TEXT] [--json FILE]\n"
+                                     "       %s --compare BASE.json NEW.json [--threshold PCT]\n", argv[0], argv[0]);
+                std::exit(2);
+            }
+        }
+        if (m_helperCpu < 0)
+        {
+            m_helperCpu = m_cpu;
+        }
+        if (!comparing())
+        {
+            pinToCpu(m_cpu);
+            if (std::strcmp(MUDUO_BENCH_BUILD_TYPE, "Release") != 0)
+            {
+                std::fprintf(stderr, "warning: %s is a %s build, its numbers do not reflect release performance\n",
+                             argv[0], MUDUO_BENCH_BUILD_TYPE);
+            }
+        }
+    }
+
+    [[nodiscard]] bool comparing() const { return m_compareBase != nullptr; }
+    int runComparison() const { return compare(m_compareBase, m_compareCurrent, m_threshold); }
+
+    [[nodiscard]] int helperCpu() const { return m_helperCpu; }
+
+    [[nodiscard]] bool enabled(const std::string &inName) const
+    {
+        return m_filter.empty() || inName.find(m_filter) != std::string::npos;
+    }
+
+    /**
+     * @brief Runs inBody once to warm up, then --repetitions times
+     * @param inBody Performs inOps operations and returns the nanoseconds they took
+     */
+    void measure(const std::string &inName, uint64_t inOps, const std::function<int64_t(uint64_t)> &inBody)
+    {
+        if (!enabled(inName))
+        {
+            return;
+        }
+        inBody(std::max<uint64_t>(inOps / 10, 1));
+        std::vector<double> perOp;
+        for (int i = 0; i < m_repetitions; ++i)
+        {
+            perOp.push_back(static_cast<double>(inBody(inOps)) / static_cast<double>(inOps));
+        }
+        std::sort(perOp.begin(), perOp.end());
+        add(Result{inName, "ns/op", perOp[perOp.size() / 2], perOp.front(), inOps});
+    }
+
+    /**
+     * @brief Reports the p50 and p99 of individually timed samples, in ns
+     */
+    void distribution(const std::string &inName, std::vector<int64_t> inSamples)
+    {
+        if (inSamples.empty())
+        {
+            return;
+        }
+        std::sort(inSamples.begin(), inSamples.end());
+        const auto at = [&](double inQuantile) {
+            return static_cast<double>(inSamples[static_cast<size_t>(inQuantile * static_cast<double>(inSamples.size() - 1))]);
+        };
+        add(Result{inName + ".p50", "ns", at(0.5), static_cast<double>(inSamples.front()), inSamples.size()});
+        add(Result{inName + ".p99", "ns", at(0.99), static_cast<double>(inSamples.front()), inSamples.size()});
+    }
+
+    /**
+     * @brief Writes the JSON file if requested
+     * @return Exit code for main()
+     */
+    int finish() const
+    {
+        if (m_jsonPath == nullptr)
+        {
+            return 0;
+        }
+        FILE *out = std::fopen(m_jsonPath, "w");
+        if (out == nullptr)
+        {
+            std::perror(m_jsonPath);
+            return 1;
+        }
+        const BuildInfo build = currentBuild();
+        std::fprintf(out, "{\n  \"suite\": \"%s\",\n  \"cpu\": %d,\n  \"repetitions\": %d,\n", m_name, m_cpu, m_repetitions);
+        std::fprintf(out, "  \"build_type\": \"%s\",\n  \"compiler\": \"%s\",\n  \"cxx_flags\": \"%s\",\n  \"results\": [\n",
+                     jsonEscape(build.buildType).c_str(), jsonEscape(build.compiler).c_str(),
+                     jsonEscape(build.cxxFlags).c_str());
+        for (size_t i = 0; i < m_results.size(); ++i)
+        {
+            const Result &r = m_results[i];
+            std::fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"median\": %.3f, \"min\": %.3f, \"ops\": %llu}%s\n",
+                         r.name.c_str(), r.unit.c_str(), r.median, r.min,
+                         static_cast<unsigned long long>(r.ops), i + 1 < m_results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+        std::fclose(out);
+        return 0;
+    }
+
+private:
+    void add(Result inResult)
+    {
+        std::printf("%-40s %12.2f %-6s (min %.2f)\n",
+                    inResult.name.c_str(), inResult.median, inResult.unit.c_str(), inResult.min);
+        std::fflush(stdout);
+        m_results.push_back(std::move(inResult));
+    }
+
+    const char *m_name;
+    int m_cpu{-1};
+    int m_helperCpu{-1};
+    int m_repetitions{5};
+    std::string m_filter;
+    const char *m_jsonPath{nullptr};
+    const char *m_compareBase{nullptr};
+    const char *m_compareCurrent{nullptr};
+    double m_threshold{5.0};
+    std::vector<Result> m_results;
+};
+
+}  // namespace bench
@@ -0,0 +1,127 @@
+/**
+ * @brief Buffer primitives: append, growth and compaction (makeSpace) and readFd
+ *
+ * Usage: BufferBench [--cpu N] [--json FILE] [--filter TEXT] [--repetitions N]
+ *        BufferBench --compare BASE.json NEW.json [--threshold PCT]
+ */
+#include "BenchHarness.h"
+#include "Buffer.h"
+
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+void benchAppend(bench::Suite &ioSuite, size_t inSize)
+{
+    const std::string data(inSize, 'x');
+    ioSuite.measure("buffer.append." + std::to_string(inSize) + "B", 1000000, [&](uint64_t inOps) {
+        Buffer buffer;
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; ++i)
+        {
+            buffer.append(data.data(), data.size());
+            if (buffer.readableBytes() >= 64 * 1024)
+            {
+                buffer.retrieveAll();
+            }
+        }
+        bench::doNotOptimize(buffer.peek());
+        return bench::nowNanos() - start;
+    });
+}
+
+/**
+ * @brief A consumer that lags behind by a few bytes, so makeSpace keeps moving
+ *        the unread tail to the front instead of growing
+ */
+void benchCompact(bench::Suite &ioSuite)
+{
+    const std::string data(1024, 'x');
+    ioSuite.measure("buffer.makeSpace.compact.1KB", 1000000, [&](uint64_t inOps) {
+        Buffer buffer(4096);
+        buffer.append(data.data(), 100);
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; ++i)
+        {
+            buffer.append(data.data(), data.size());
+            buffer.retrieve(data.size());
+        }
+        bench::doNotOptimize(buffer.peek());
+        return bench::nowNanos() - start;
+    });
+}
+
+void benchGrow(bench::Suite &ioSuite)
+{
+    const std::string data(1024, 'x');
+    ioSuite.measure("buffer.makeSpace.grow.64KB", 20000, [&](uint64_t inOps) {
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; ++i)
+        {
+            Buffer buffer;
+            for (int chunk = 0; chunk < 64; ++chunk)
+            {
+                buffer.append(data.data(), data.size());
+            }
+            bench::doNotOptimize(buffer.peek());
+        }
+        return bench::nowNanos() - start;
+    });
+}
+
+/**
+ * @brief Times readFd alone; the socketpair is refilled outside the measurement
+ */
+void benchReadFd(bench::Suite &ioSuite, size_t inSize)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        std::perror("socketpair");
+        return;
+    }
+    const std::string data(inSize, 'x');
+    ioSuite.measure("buffer.readFd." + std::to_string(inSize / 1024) + "KB", 20000, [&](uint64_t inOps) {
+        Buffer buffer;
+        int savedErrno = 0;
+        int64_t elapsed = 0;
+        for (uint64_t i = 0; i < inOps; ++i)
+        {
+            if (::write(fds[1], data.data(), data.size()) != static_cast<ssize_t>(data.size()))
+            {
+                std::perror("write");
+                std::exit(1);
+            }
+            const int64_t start = bench::nowNanos();
+            buffer.readFd(fds[0], &savedErrno);
+            elapsed += bench::nowNanos() - start;
+            buffer.retrieveAll();
+        }
+        return elapsed;
+    });
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    bench::Suite suite("BufferBench", argc, argv);
+    if (suite.comparing())
+    {
+        return suite.runComparison();
+    }
+
+    benchAppend(suite, 16);
+    benchAppend(suite, 256);
+    benchAppend(suite, 4096);
+    benchCompact(suite);
+    benchGrow(suite);
+    benchReadFd(suite, 4 * 1024);
+    benchReadFd(suite, 64 * 1024);
+    return suite.finish();
+}
@@ -0,0 +1,99 @@
+/**
+ * @brief Compares Buffer's vectorized searches with the scalar std algorithms
+ *
+ * Usage: BufferSearchBench [megabytes]
+ * Set MUDUO_BUFFER_SIMD=scalar|sse2|avx2 to pin the Buffer implementation.
+ */
+#include "Buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+namespace
+{
+constexpr int kRounds = 20;
+
+/**
+ * @brief Runs inSearch kRounds times over inBytes and prints the throughput
+ * @return Offset of the match reported by the last round, for cross-checking
+ */
+size_t run(const char *inLabel, size_t inBytes, const std::function<const char*()> &inSearch, const char *inBase)
+{
+    const char *match = nullptr;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; ++i)
+    {
+        match = inSearch();
+        asm volatile("" : : "r"(match) : "memory");
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double gbPerSec = static_cast<double>(inBytes) * kRounds / elapsed.count() / 1e9;
+    std::printf("%-28s %8.2f GB/s\n", inLabel, gbPerSec);
+    return match ? static_cast<size_t>(match - inBase) : std::string::npos;
+}
+
+void check(const char *inWhat, size_t inExpected, size_t inActual)
+{
+    if (inExpected != inActual)
+    {
+        std::fprintf(stderr, "%s mismatch: expected %zu, got %zu\n", inWhat, inExpected, inActual);
+        std::exit(1);
+    }
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    const size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    const size_t size = megabytes * 1024 * 1024;
+
+    // A large pipelined body with the only terminator at the very end, so every
+    // search scans the whole region (the worst case for a header parser)
+    std::string payload(size, 'x');
+    for (size_t i = 0; i < size; i += 61)
+    {
+        payload[i] = (i % 2) ? '\r' : ':';
+    }
+    payload.replace(size - 4, 4, "\r\n\r\n");
+
+    Buffer buffer(size);
+    buffer.append(payload.data(), payload.size());
+    const char *begin = buffer.peek();
+    const char *end = buffer.beginWrite();
+
+    std::printf("scanning %zu MB, %d rounds\n", megabytes, kRounds);
+
+    static const char kCRLF[] = "\r\n";
+    static const char kBlankLine[] = "\r\n\r\n";
+    static const char kSet[] = "\n;";
+
+    size_t expected = run("std::search CRLF", size, [&] {
+        const char *p = std::search(begin, end, kCRLF, kCRLF + 2);
+        return p == end ? nullptr : p;
+    }, begin);
+    check("findCRLF", expected, run("Buffer::findCRLF", size, [&] { return buffer.findCRLF(); }, begin));
+
+    expected = run("std::find EOL", size, [&] {
+        const char *p = std::find(begin, end, '\n');
+        return p == end ? nullptr : p;
+    }, begin);
+    check("findEOL", expected, run("Buffer::findEOL", size, [&] { return buffer.findEOL(); }, begin));
+
+    expected = run("std::search CRLFCRLF", size, [&] {
+        const char *p = std::search(begin, end, kBlankLine, kBlankLine + 4);
+        return p == end ? nullptr : p;
+    }, begin);
+    check("find", expected, run("Buffer::find CRLFCRLF", size, [&] { return buffer.find(kBlankLine); }, begin));
+
+    expected = run("std::find_first_of {\\n;}", size, [&] {
+        const char *p = std::find_first_of(begin, end, kSet, kSet + 2);
+        return p == end ? nullptr : p;
+    }, begin);
+    check("findAny", expected, run("Buffer::findAny {\\n;}", size, [&] { return buffer.findAny(kSet); }, begin));
+
+    return 0;
+}
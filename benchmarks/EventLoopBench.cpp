@@ -0,0 +1,189 @@
+/**
+ * @brief EventLoop and Poller primitives: cross-thread queueInLoop/runInLoop,
+ *        Channel update churn and poll + dispatch overhead per event
+ *
+ * Usage: EventLoopBench [--cpu N] [--helper-cpu N] [--json FILE] [--filter TEXT] [--repetitions N]
+ *        EventLoopBench --compare BASE.json NEW.json [--threshold PCT]
+ * The loop thread of the cross-thread benchmarks is pinned to --helper-cpu;
+ * pass a different CPU than --cpu to measure a real cross-core handoff.
+ */
+#include "BenchHarness.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <memory>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+void waitFor(const std::atomic<bool> &inFlag)
+{
+    while (!inFlag.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief One-way latency from runInLoop() on this thread to the functor starting on the loop thread
+ */
+void benchCrossThreadLatency(bench::Suite &ioSuite, EventLoop *inLoop)
+{
+    const std::string name = "loop.runInLoop.crossThread.latency";
+    if (!ioSuite.enabled(name))
+    {
+        return;
+    }
+    constexpr int kSamples = 20000;
+    std::vector<int64_t> samples;
+    samples.reserve(kSamples);
+    std::atomic<bool> done{false};
+    for (int i = 0; i < kSamples; ++i)
+    {
+        done.store(false, std::memory_order_relaxed);
+        const int64_t sent = bench::nowNanos();
+        int64_t received = 0;
+        inLoop->runInLoop([&]() {
+            received = bench::nowNanos();
+            done.store(true, std::memory_order_release);
+        });
+        waitFor(done);
+        samples.push_back(received - sent);
+    }
+    ioSuite.distribution(name, std::move(samples));
+}
+
+/**
+ * @brief Functors posted back to back from another thread, amortized per functor
+ */
+void benchCrossThreadThroughput(bench::Suite &ioSuite, EventLoop *inLoop)
+{
+    ioSuite.measure("loop.queueInLoop.crossThread.throughput", 200000, [&](uint64_t inOps) {
+        std::atomic<bool> done{false};
+        uint64_t ran = 0;  // loop thread only
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; ++i)
+        {
+            inLoop->queueInLoop([&ran, &done, inOps]() {
+                if (++ran == inOps)
+                {
+                    done.store(true, std::memory_order_release);
+                }
+            });
+        }
+        waitFor(done);
+        return bench::nowNanos() - start;
+    });
+}
+
+/**
+ * @brief epoll_ctl churn through Channel, EventLoop and EPollPoller; one op is one update
+ */
+void benchChannelUpdates(bench::Suite &ioSuite)
+{
+    EventLoop loop;
+    const int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(&loop, fd);
+    channel.enableReading();
+
+    // EPOLL_CTL_MOD
+    ioSuite.measure("channel.update.modify", 200000, [&](uint64_t inOps) {
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; i += 2)
+        {
+            channel.enableWriting();
+            channel.disableWriting();
+        }
+        return bench::nowNanos() - start;
+    });
+
+    // EPOLL_CTL_DEL and EPOLL_CTL_ADD, plus the Poller's channel map erase and insert
+    channel.disableAll();
+    channel.remove();
+    ioSuite.measure("channel.update.addRemove", 200000, [&](uint64_t inOps) {
+        const int64_t start = bench::nowNanos();
+        for (uint64_t i = 0; i < inOps; i += 2)
+        {
+            channel.enableReading();
+            channel.disableAll();
+            channel.remove();
+        }
+        return bench::nowNanos() - start;
+    });
+    ::close(fd);
+}
+
+/**
+ * @brief EventLoop iterations over inChannels always-readable eventfds; one op is one dispatched event
+ */
+void benchPollDispatch(bench::Suite &ioSuite, size_t inChannels)
+{
+    EventLoop loop;
+    std::vector<int> fds;
+    std::vector<std::unique_ptr<Channel>> channels;
+    uint64_t handled = 0;
+    uint64_t target = 0;
+    for (size_t i = 0; i < inChannels; ++i)
+    {
+        // Level-triggered and never drained, so every poll reports all of them
+        const int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+        fds.push_back(fd);
+        channels.push_back(std::make_unique<Channel>(&loop, fd));
+        channels.back()->setReadCallback([&](Timestamp) {
+            if (++handled == target)
+            {
+                loop.quit();
+            }
+        });
+        channels.back()->enableReading();
+    }
+
+    ioSuite.measure("poller.dispatch." + std::to_string(inChannels) + "ch", 200000, [&](uint64_t inOps) {
+        handled = 0;
+        target = inOps;
+        const int64_t start = bench::nowNanos();
+        loop.loop();
+        return bench::nowNanos() - start;
+    });
+
+    for (auto &channel : channels)
+    {
+        channel->disableAll();
+        channel->remove();
+    }
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    bench::Suite suite("EventLoopBench", argc, argv);
+    if (suite.comparing())
+    {
+        return suite.runComparison();
+    }
+    Logger::setLogLevel(ERROR);
+
+    {
+        const int helperCpu = suite.helperCpu();
+        EventLoopThread loopThread([helperCpu](EventLoop*) { bench::pinToCpu(helperCpu); }, "bench-loop");
+        EventLoop *loop = loopThread.startLoop();
+        benchCrossThreadLatency(suite, loop);
+        benchCrossThreadThroughput(suite, loop);
+    }
+    benchChannelUpdates(suite);
+    benchPollDispatch(suite, 1);
+    benchPollDispatch(suite, 64);
+    return suite.finish();
+}
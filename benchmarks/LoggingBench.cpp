@@ -0,0 +1,106 @@
+/**
+ * @brief Messages per second per thread through LOG_INFO with different outputs
+ *
+ * Usage: LoggingBench [threads] [messages per thread] [log basename]
+ *   null   formatting only, output discarded
+ *   sync   write + flush per line to a file under a lock (the old std::endl path)
+ *   async  AsyncLogging backend writing <basename>.*.log
+ *   mmap   MmapLogFile writing <basename>.mmap.*.log
+ *   binary BinaryLog writing <basename>.bin, formatted later by BinaryLogDecoder
+ */
+#include "AsyncLogging.h"
+#include "BinaryLog.h"
+#include "Logger.h"
+#include "MmapLogFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+void run(const char *inLabel, int inThreads, int inMessages)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < inThreads; ++t)
+    {
+        threads.emplace_back([inMessages, t]() {
+            for (int i = 0; i < inMessages; ++i)
+            {
+                LOG_INFO("LoggingBench thread {} message {} payload {}\n", t, i, "0123456789abcdef");
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    Logger::instance().flush();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double perThread = inMessages / elapsed.count();
+    std::fprintf(stderr, "%-6s %2d threads %12.0f msg/s per thread %12.0f msg/s total\n",
+                 inLabel, inThreads, perThread, perThread * inThreads);
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    const int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    const int messages = argc > 2 ? std::atoi(argv[2]) : 200000;
+    const std::string basename = argc > 3 ? argv[3] : "/tmp/LoggingBench";
+    Logger &logger = Logger::instance();
+
+    logger.setOutput([](const char*, size_t) {});
+    logger.setFlush([]() {});
+    run("null", threads, messages);
+
+    const std::string syncName = basename + ".sync.log";
+    FILE *fp = std::fopen(syncName.c_str(), "w");
+    std::mutex fileMutex;
+    logger.setOutput([fp, &fileMutex](const char *msg, size_t len) {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        std::fwrite(msg, 1, len, fp);
+        std::fflush(fp);
+    });
+    logger.setFlush([fp]() { std::fflush(fp); });
+    run("sync", threads, messages);
+    std::fclose(fp);
+
+    AsyncLogging async(basename);
+    async.start();
+    logger.setOutput([&async](const char *msg, size_t len) { async.append(msg, len); });
+    logger.setFlush([&async]() { async.flush(); });
+    run("async", threads, messages);
+    std::fprintf(stderr, "async dropped %lu bytes\n", static_cast<unsigned long>(async.droppedBytes()));
+
+    logger.setOutput(nullptr);
+    logger.setFlush(nullptr);
+    async.stop();
+
+    {
+        MmapLogFile mapped(basename + ".mmap");
+        mapped.start();
+        logger.setOutput([&mapped](const char *msg, size_t len) { mapped.append(msg, len); });
+        logger.setFlush([&mapped]() { mapped.flush(); });
+        run("mmap", threads, messages);
+        logger.setOutput(nullptr);
+        logger.setFlush(nullptr);
+        mapped.stop();
+        std::fprintf(stderr, "mmap dropped %lu bytes in %lu files\n",
+                     static_cast<unsigned long>(mapped.droppedBytes()),
+                     static_cast<unsigned long>(mapped.closedFiles()));
+    }
+
+    BinaryLog &binary = BinaryLog::instance();
+    binary.start(basename + ".bin", 8 << 20);
+    run("binary", threads, messages);
+    binary.stop();
+    std::fprintf(stderr, "binary dropped %lu records\n", static_cast<unsigned long>(binary.droppedRecords()));
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @brief Request/response latency over loopback for each SocketProfile
+ *
+ * Usage: SocketProfileBench [seconds per profile] [port]
+ * The server answers every 64-byte request with two separate 32-byte sends, the
+ * pattern that stalls on Nagle plus delayed ACKs when TCP_NODELAY is off.
+ */
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Socket.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr size_t kRequestSize = 64;
+constexpr size_t kHalfResponse = 32;
+
+/**
+ * @brief Runs an echo-like server with inProfile until the returned loop is quit
+ */
+EventLoop* startServer(SocketProfile inProfile, uint16_t inPort, std::thread *outThread)
+{
+    std::promise<EventLoop*> ready;
+    *outThread = std::thread([&ready, inProfile, inPort]() {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(inPort), "SocketProfileBench");
+        server.setSocketProfile(inProfile);
+        server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            while (buf->readableBytes() >= kRequestSize)
+            {
+                buf->retrieve(kRequestSize);
+                conn->send(std::string(kHalfResponse, 'a'));
+                conn->send(std::string(kHalfResponse, 'b'));
+            }
+        });
+        server.start();
+        ready.set_value(&loop);
+        loop.loop();
+    });
+    return ready.get_future().get();
+}
+
+bool readFully(int inFd, char *outBuf, size_t inLen)
+{
+    size_t got = 0;
+    while (got < inLen)
+    {
+        const ssize_t n = ::read(inFd, outBuf + got, inLen - got);
+        if (n <= 0)
+        {
+            return false;
+        }
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Sends requests one at a time for inSeconds and prints the latency distribution
+ */
+void measure(const char *inLabel, uint16_t inPort, double inSeconds)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // isolate the server side
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(inPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        std::perror("connect");
+        std::exit(1);
+    }
+
+    const std::string request(kRequestSize, 'q');
+    char response[2 * kHalfResponse];
+    std::vector<double> latenciesUs;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(inSeconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (::write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())
+            || !readFully(fd, response, sizeof(response)))
+        {
+            std::perror("request");
+            break;
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        latenciesUs.push_back(elapsed.count());
+    }
+    ::close(fd);
+
+    if (latenciesUs.empty())
+    {
+        return;
+    }
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    const auto percentile = [&latenciesUs](double p) {
+        return latenciesUs[std::min(latenciesUs.size() - 1, static_cast<size_t>(p * latenciesUs.size()))];
+    };
+    std::printf("%-12s %9zu req %10.0f req/s  p50 %9.1f us  p99 %9.1f us  max %9.1f us\n",
+                inLabel, latenciesUs.size(), latenciesUs.size() / inSeconds,
+                percentile(0.50), percentile(0.99), latenciesUs.back());
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    const uint16_t basePort = argc > 2 ? static_cast<uint16_t>(std::atoi(argv[2])) : 9981;
+
+    const std::pair<const char*, SocketProfile> profiles[] = {
+        {"default", SocketProfile::Default},
+        {"latency", SocketProfile::Latency},
+        {"throughput", SocketProfile::Throughput},
+    };
+
+    uint16_t port = basePort;
+    for (const auto &[label, profile] : profiles)
+    {
+        std::thread serverThread;
+        EventLoop *loop = startServer(profile, port, &serverThread);
+        measure(label, port, seconds);
+        loop->quit();
+        serverThread.join();
+        ++port;
+    }
+    return 0;
+}
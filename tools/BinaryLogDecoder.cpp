@@ -0,0 +1,45 @@
+/**
+ * @brief Converts a file written by BinaryLog into text
+ *
+ * Usage: BinaryLogDecoder <binary log> [output file]
+ * Writes to stdout when no output file is given.
+ */
+#include "BinaryLog.h"
+
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s <binary log> [output file]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *input = std::fopen(argv[1], "rb");
+    if (input == nullptr)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+    FILE *output = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+    if (output == nullptr)
+    {
+        std::perror(argv[2]);
+        std::fclose(input);
+        return 1;
+    }
+
+    const bool ok = BinaryLog::decode(input, output);
+    std::fclose(input);
+    if (output != stdout)
+    {
+        std::fclose(output);
+    }
+    if (!ok)
+    {
+        std::fprintf(stderr, "%s: not a binary log or truncated\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}